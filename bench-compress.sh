@@ -0,0 +1,59 @@
+#!/bin/bash
+# Compare the --compress modes on loopback: how many bytes the workers
+# send back, and how much CPU the workers and the driver burn to do it.
+#
+# usage: bench-compress.sh input nr_workers [mode ...]
+#
+# Modes are anything --compress takes; the default is none, deflate:1
+# and deflate:6.  Extra driver and worker arguments (e.g. --encoding
+# compact) can be passed in DRIVER_ARGS and WORKER_ARGS.
+set -e
+
+if [ $# -lt 2 ]; then
+	echo "usage: $0 input nr_workers [mode ...]" >&2
+	exit 1
+fi
+input=$1
+nr_workers=$2
+shift 2
+modes=${*:-none deflate:1 deflate:6}
+bin=$(dirname "$0")
+tmp=$(mktemp -d)
+trap 'rm -rf $tmp' EXIT
+TIMEFORMAT="%U %S"
+
+"$bin/chunk" "$input" "$nr_workers" "$tmp/chunk" > /dev/null
+
+printf "%-12s %12s %8s %12s %12s %10s\n" mode bytes ratio worker_cpu driver_cpu wall
+for mode in $modes; do
+	# Bytes on the wire, from the same workers in --stdin mode
+	bytes=0
+	for i in $(seq 0 $((nr_workers - 1))); do
+		b=$("$bin/worker" $WORKER_ARGS --compress "$mode" --stdin < "$tmp/chunk_$i" | wc -c)
+		bytes=$((bytes + b))
+	done
+	[ "$mode" = none ] && base_bytes=$bytes
+
+	port=$((20000 + RANDOM % 20000))
+	args=
+	pids=
+	for i in $(seq 0 $((nr_workers - 1))); do
+		p1=$((port + 2 * i))
+		p2=$((port + 2 * i + 1))
+		{ time "$bin/worker" $WORKER_ARGS $p1 $p2 > /dev/null 2>&1 ; } 2> "$tmp/worker_$i" &
+		pids="$pids $!"
+		args="$args 127.0.0.1 $p1 $p2"
+	done
+	sleep 0.5
+	start=$(date +%s.%N)
+	{ time "$bin/driver" $DRIVER_ARGS --compress "$mode" "$input" $args > /dev/null 2>&1 ; } 2> "$tmp/driver"
+	end=$(date +%s.%N)
+	wait $pids
+
+	worker_cpu=$(cat "$tmp"/worker_* | awk '{t += $1 + $2} END {print t}')
+	driver_cpu=$(awk '{print $1 + $2}' "$tmp/driver")
+	printf "%-12s %12d %8.3f %12.2f %12.2f %10.2f\n" "$mode" "$bytes" \
+	       $(echo "$bytes ${base_bytes:-$bytes}" | awk '{print $1 / $2}') \
+	       "$worker_cpu" "$driver_cpu" \
+	       $(echo "$start $end" | awk '{print $2 - $1}')
+done
@@ -0,0 +1,608 @@
+/* Benchmark harness.  Generates a deterministic synthetic corpus and
+   times each stage of the pipeline over it: the tokenizer on its
+   own, tokenizing into the word table, the workers, the driver's
+   merge with each engine, and the whole thing end to end over
+   loopback.  Each phase is reported as one line of JSON on stdout.
+   The word table phase is run once per hash function, each followed
+   by a line describing how the words ended up laid out in the
+   table. */
+#define _GNU_SOURCE
+#include <sys/types.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <err.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <math.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "dwc.h"
+
+static enum { CORPUS_ZIPF, CORPUS_UNIQUE, CORPUS_HUGE } corpus = CORPUS_ZIPF;
+static const char *corpus_names[] = { "zipf", "unique", "huge" };
+static size_t corpus_size = 64 << 20;
+static unsigned vocab = 100000;
+static double zipf_s = 1.0;
+static uint64_t seed = 1;
+static int nr_workers = 4;
+static unsigned bench_hash = HASH_MIX;
+static bool bench_utf8;
+#define MAX_WORKERS 16
+static char *bin_dir;
+static char *tmp_dir;
+/* Everything spawn() started which wait_all() hasn't collected yet */
+static pid_t children[MAX_WORKERS + 1];
+static int nr_children;
+
+static uint64_t
+splitmix64(uint64_t *state)
+{
+	uint64_t z = (*state += 0x9e3779b97f4a7c15ull);
+
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+	return z ^ (z >> 31);
+}
+
+static double
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* The word with a given Zipf rank.  The same rank always gives the
+   same word, whatever the seed. */
+static unsigned
+vocab_word(unsigned rank, char *buf)
+{
+	uint64_t state = rank;
+	uint64_t h = splitmix64(&state);
+	unsigned len = 3 + h % 10;
+	unsigned x;
+
+	h >>= 4;
+	for (x = 0; x < len; x++) {
+		buf[x] = "abcdefghijklmnopqrstuvwxyz0123456789"[h % 36];
+		h = h / 36 ? h / 36 : splitmix64(&state);
+	}
+	return len;
+}
+
+static void
+generate_corpus(const char *path)
+{
+	FILE *f;
+	double *cdf;
+	double total;
+	uint64_t state;
+	size_t written;
+	unsigned words_on_line;
+	unsigned lo, hi, mid;
+	unsigned len;
+	unsigned x;
+	char buf[64];
+	double u;
+
+	f = fopen(path, "w");
+	if (!f)
+		err(1, "creating %s", path);
+	state = seed;
+	written = 0;
+	words_on_line = 0;
+
+	switch (corpus) {
+	case CORPUS_ZIPF:
+		cdf = malloc(vocab * sizeof(cdf[0]));
+		if (!cdf)
+			err(1, "allocating Zipf table");
+		total = 0;
+		for (x = 0; x < vocab; x++) {
+			total += 1 / pow(x + 1, zipf_s);
+			cdf[x] = total;
+		}
+		while (written < corpus_size) {
+			u = (splitmix64(&state) >> 11) * (1.0 / 9007199254740992.0) * total;
+			lo = 0;
+			hi = vocab - 1;
+			while (lo < hi) {
+				mid = (lo + hi) / 2;
+				if (cdf[mid] < u)
+					lo = mid + 1;
+				else
+					hi = mid;
+			}
+			len = vocab_word(lo, buf);
+			/* Some capitals, so that case folding gets
+			   exercised too */
+			if (splitmix64(&state) % 16 == 0)
+				buf[0] &= ~0x20;
+			buf[len++] = ++words_on_line % 12 ? ' ' : '\n';
+			fwrite(buf, len, 1, f);
+			written += len;
+		}
+		free(cdf);
+		break;
+	case CORPUS_UNIQUE:
+		for (x = 0; written < corpus_size; x++) {
+			len = sprintf(buf, "%ux%llx%c", x,
+				      (unsigned long long)(splitmix64(&state) & 0xffffff),
+				      ++words_on_line % 12 ? ' ' : '\n');
+			fwrite(buf, len, 1, f);
+			written += len;
+		}
+		break;
+	case CORPUS_HUGE:
+		/* One enormous word with a little text either side */
+		fputs("start of the huge word ", f);
+		for (written = 0; written < corpus_size; written++)
+			putc('x', f);
+		fputs(" end of the huge word\n", f);
+		break;
+	}
+	if (fclose(f) == EOF)
+		err(1, "writing %s", path);
+}
+
+static long
+max_rss_kb(void)
+{
+	struct rusage ru;
+
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_maxrss;
+}
+
+static void
+report(const char *phase, unsigned hash, size_t bytes, size_t words,
+       double seconds, long rss_kb)
+{
+	printf("{\"phase\": \"%s\", \"corpus\": \"%s\", \"hash\": \"%s\", "
+	       "\"utf8\": %s, "
+	       "\"bytes\": %zd, \"words\": %zd, \"seconds\": %.6f, "
+	       "\"mb_per_s\": %.2f, \"words_per_s\": %.0f, \"max_rss_kb\": %ld}\n",
+	       phase, corpus_names[corpus], hash_function_names[hash],
+	       bench_utf8 ? "true" : "false", bytes,
+	       words, seconds, bytes / seconds / (1 << 20), words / seconds,
+	       rss_kb);
+	fflush(stdout);
+}
+
+/* How far words are from their home cells, how long the clusters
+   are, and how many words share an order key with their neighbour,
+   which is what makes lookups have to compare strings. */
+static void
+report_table(const struct word_table *t)
+{
+	unsigned x;
+	unsigned home;
+	unsigned run;
+	unsigned max_run;
+	unsigned max_displacement;
+	unsigned long long displacement;
+	unsigned long long collisions;
+
+	run = max_run = max_displacement = 0;
+	displacement = collisions = 0;
+	for (x = 0; x < t->nr_cells; x++) {
+		if (!t->cells[x].word) {
+			run = 0;
+			continue;
+		}
+		if (++run > max_run)
+			max_run = run;
+		home = word_home(t, t->cells[x].key);
+		displacement += x - home;
+		if (x - home > max_displacement)
+			max_displacement = x - home;
+		if (run > 1 && t->cells[x - 1].key == t->cells[x].key)
+			collisions++;
+	}
+	printf("{\"phase\": \"table\", \"corpus\": \"%s\", \"hash\": \"%s\", "
+	       "\"distinct_words\": %u, \"cells\": %u, "
+	       "\"mean_displacement\": %.3f, \"max_displacement\": %u, "
+	       "\"max_cluster\": %u, \"key_collisions\": %llu}\n",
+	       corpus_names[corpus], hash_function_names[hash_function],
+	       t->nr_used, t->nr_cells,
+	       t->nr_used ? (double)displacement / t->nr_used : 0,
+	       max_displacement, max_run, collisions);
+	fflush(stdout);
+}
+
+static unsigned char *
+load_corpus(const char *path, size_t *size)
+{
+	struct stat st;
+	unsigned char *buf;
+	size_t done;
+	ssize_t r;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0 || fstat(fd, &st) < 0)
+		err(1, "opening %s", path);
+	*size = st.st_size;
+	buf = malloc(*size + 2 + TOKENIZE_PAD);
+	if (!buf)
+		err(1, "allocating corpus buffer");
+	for (done = 0; done < *size; done += r) {
+		r = read(fd, buf + done, *size - done);
+		if (r <= 0)
+			err(1, "reading %s", path);
+	}
+	close(fd);
+	buf[*size] = ' ';
+	buf[*size + 1] = 'X';
+	return buf;
+}
+
+/* Same loop as the worker's count_range() */
+static size_t
+tokenize(const unsigned char *buf, size_t size, unsigned char *word_buf,
+	 bool insert)
+{
+	unsigned pos;
+	unsigned word_end;
+	unsigned len;
+	size_t words;
+
+	words = 0;
+	pos = 0;
+	while (1) {
+		if (pos >= 1u << 30) {
+			buf += pos;
+			size -= pos;
+			pos = 0;
+		}
+		pos = tok_skip_spaces(buf, pos);
+		if (pos >= size)
+			break;
+		word_end = tok_fold_word(buf, pos, word_buf, &len);
+		if (insert)
+			bump_word_counter(word_buf, len, 1);
+		words++;
+		pos = word_end;
+	}
+	return words;
+}
+
+/* Start a program from bin_dir, with stdin from in (if it isn't NULL)
+   and stdout to out (or /dev/null), and return its pid.  wait_all()
+   collects it. */
+static pid_t
+spawn(char **argv, const char *in, const char *out)
+{
+	char *path;
+	pid_t pid;
+	int fd;
+
+	if (asprintf(&path, "%s/%s", bin_dir, argv[0]) < 0)
+		err(1, "asprintf");
+	pid = fork();
+	if (pid < 0)
+		err(1, "fork");
+	if (pid == 0) {
+		if (in) {
+			fd = open(in, O_RDONLY);
+			if (fd < 0 || dup2(fd, 0) < 0)
+				err(1, "redirecting stdin from %s", in);
+		}
+		fd = open(out ? out : "/dev/null", O_WRONLY | O_CREAT | O_TRUNC, 0666);
+		if (fd < 0 || dup2(fd, 1) < 0)
+			err(1, "redirecting stdout");
+		fd = open("/dev/null", O_WRONLY);
+		dup2(fd, 2);
+		execv(path, argv);
+		err(1, "exec %s", path);
+	}
+	free(path);
+	children[nr_children++] = pid;
+	return pid;
+}
+
+/* When a phase fails, the rest of it mustn't be left running, holding
+   ports or waiting for a driver which will never come */
+static void
+kill_children(void)
+{
+	int x;
+
+	for (x = 0; x < nr_children; x++)
+		kill(children[x], SIGTERM);
+	while (wait(NULL) > 0)
+		;
+	nr_children = 0;
+}
+
+static void
+forget_child(pid_t pid)
+{
+	int x;
+
+	for (x = 0; x < nr_children; x++) {
+		if (children[x] == pid) {
+			children[x] = children[--nr_children];
+			return;
+		}
+	}
+}
+
+/* Wait for every child, and return the biggest peak RSS of them */
+static long
+wait_all(int nr)
+{
+	struct rusage ru;
+	long rss;
+	pid_t pid;
+	int status;
+
+	rss = 0;
+	while (nr--) {
+		pid = wait4(-1, &status, 0, &ru);
+		if (pid < 0)
+			err(1, "wait4");
+		forget_child(pid);
+		if (!WIFEXITED(status) || WEXITSTATUS(status)) {
+			kill_children();
+			errx(1, "a child failed");
+		}
+		if (ru.ru_maxrss > rss)
+			rss = ru.ru_maxrss;
+	}
+	return rss;
+}
+
+/* Whether anything's listening on TCP port p.  A worker accepts just
+   one connection on each of its ports, so trying to connect would
+   use it up; /proc/net/tcp says without touching it. */
+static bool
+port_listening(int p)
+{
+	char line[256];
+	unsigned local_port;
+	unsigned state;
+	bool found;
+	FILE *f;
+
+	f = fopen("/proc/net/tcp", "r");
+	if (!f)
+		err(1, "opening /proc/net/tcp");
+	found = false;
+	while (!found && fgets(line, sizeof(line), f))
+		found = sscanf(line, " %*u: %*x:%x %*x:%*x %x",
+			       &local_port, &state) == 2 &&
+			local_port == p && state == 0x0a; /* TCP_LISTEN */
+	fclose(f);
+	return found;
+}
+
+/* Wait until ports first up to first + nr - 1 are all listening.  A
+   worker which can't bind its port exits, so that's a failure too. */
+static void
+wait_for_ports(int first, int nr)
+{
+	int status;
+	int tries;
+	int x;
+
+	for (tries = 0; tries < 1000; tries++) {
+		for (x = 0; x < nr && port_listening(first + x); x++)
+			;
+		if (x == nr)
+			return;
+		if (waitpid(-1, &status, WNOHANG) > 0) {
+			kill_children();
+			errx(1, "a worker exited before listening on its ports");
+		}
+		usleep(10000);
+	}
+	kill_children();
+	errx(1, "port %d still isn't listening", first + x);
+}
+
+static size_t
+file_size(const char *path)
+{
+	struct stat st;
+
+	if (stat(path, &st) < 0)
+		err(1, "stat(%s)", path);
+	return st.st_size;
+}
+
+int
+main(int argc, char *argv[])
+{
+	unsigned char *buf;
+	unsigned char *word_buf;
+	char *corpus_path;
+	char *chunk_prefix;
+	char **chunks;
+	char **outputs;
+	char *args[64];
+	size_t size;
+	size_t words;
+	size_t out_bytes;
+	char ports[2 * MAX_WORKERS][16];
+	double start;
+	long rss;
+	int port;
+	int x;
+	int y;
+	int a;
+
+	while (argc > 1) {
+		if (!strcmp(argv[1], "--utf8")) {
+			bench_utf8 = true;
+			argv++;
+			argc--;
+			continue;
+		}
+		if (argc == 2)
+			break;
+		if (!strcmp(argv[1], "--corpus")) {
+			for (x = 0; x < 3 && strcmp(argv[2], corpus_names[x]); x++)
+				;
+			if (x == 3)
+				errx(1, "--corpus wants zipf, unique or huge");
+			corpus = x;
+		} else if (!strcmp(argv[1], "--size")) {
+			corpus_size = (size_t)atoi(argv[2]) << 20;
+		} else if (!strcmp(argv[1], "--vocab")) {
+			vocab = atoi(argv[2]);
+		} else if (!strcmp(argv[1], "--zipf")) {
+			zipf_s = atof(argv[2]);
+		} else if (!strcmp(argv[1], "--seed")) {
+			seed = strtoull(argv[2], NULL, 0);
+		} else if (!strcmp(argv[1], "--hash")) {
+			bench_hash = parse_hash_function(argv[2]);
+		} else if (!strcmp(argv[1], "--workers")) {
+			nr_workers = atoi(argv[2]);
+		} else {
+			break;
+		}
+		argv += 2;
+		argc -= 2;
+	}
+	if (argc != 1)
+		errx(1, "usage: dwc-bench [--corpus zipf|unique|huge] [--size MB] [--vocab N] [--zipf s] [--seed N] [--hash legacy|mix] [--workers N] [--utf8]");
+	if (nr_workers < 1 || nr_workers > MAX_WORKERS)
+		errx(1, "--workers must be between 1 and %d", MAX_WORKERS);
+	if (!vocab || !corpus_size)
+		errx(1, "need a non-empty corpus");
+
+	bin_dir = strdup(argv[0]);
+	bin_dir = dirname(bin_dir);
+	tmp_dir = strdup("/tmp/dwc-bench.XXXXXX");
+	if (!mkdtemp(tmp_dir))
+		err(1, "creating temporary directory");
+	if (asprintf(&corpus_path, "%s/corpus", tmp_dir) < 0 ||
+	    asprintf(&chunk_prefix, "%s/chunk", tmp_dir) < 0)
+		err(1, "asprintf");
+
+	start = now();
+	generate_corpus(corpus_path);
+	fprintf(stderr, "Generated %s corpus in %.2fs\n", corpus_names[corpus],
+		now() - start);
+
+	/* In-process phases */
+	init_malloc(MALLOC_BUMP);
+	init_tokenizer(bench_utf8);
+	buf = load_corpus(corpus_path, &size);
+	word_buf = malloc(TOKENIZE_OUT_SIZE(size));
+	if (!word_buf)
+		err(1, "allocating word buffer");
+
+	start = now();
+	words = tokenize(buf, size, word_buf, false);
+	report("tokenize", bench_hash, size, words, now() - start, max_rss_kb());
+
+	for (x = 0; x < NR_HASH_FUNCTIONS; x++) {
+		hash_function = x;
+		free(word_table.cells);
+		memset(&word_table, 0, sizeof(word_table));
+		start = now();
+		words = tokenize(buf, size, word_buf, true);
+		report("insert", x, size, words, now() - start, max_rss_kb());
+		report_table(&word_table);
+	}
+	free(buf);
+	free(word_buf);
+
+	/* Workers, one per chunk, all at once */
+	chunks = calloc(nr_workers, sizeof(chunks[0]));
+	outputs = calloc(nr_workers, sizeof(outputs[0]));
+	for (x = 0; x < nr_workers; x++) {
+		if (asprintf(&chunks[x], "%s_%d", chunk_prefix, x) < 0 ||
+		    asprintf(&outputs[x], "%s/out_%d", tmp_dir, x) < 0)
+			err(1, "asprintf");
+	}
+	args[0] = "chunk";
+	args[1] = corpus_path;
+	if (asprintf(&args[2], "%d", nr_workers) < 0)
+		err(1, "asprintf");
+	args[3] = chunk_prefix;
+	args[4] = NULL;
+	spawn(args, NULL, NULL);
+	wait_all(1);
+
+	start = now();
+	args[0] = "worker";
+	args[1] = "--hash";
+	args[2] = (char *)hash_function_names[bench_hash];
+	a = 3;
+	if (bench_utf8)
+		args[a++] = "--utf8";
+	args[a++] = "--stdin";
+	args[a] = NULL;
+	for (x = 0; x < nr_workers; x++)
+		spawn(args, chunks[x], outputs[x]);
+	rss = wait_all(nr_workers);
+	report("worker", bench_hash, size, words, now() - start, rss);
+
+	out_bytes = 0;
+	for (x = 0; x < nr_workers; x++)
+		out_bytes += file_size(outputs[x]);
+
+	/* The driver's merge, from the workers' saved output */
+	for (y = 0; y < 2; y++) {
+		args[0] = "driver";
+		args[1] = "--merge";
+		args[2] = y ? "heap" : "table";
+		args[3] = "--offline";
+		for (x = 0; x < nr_workers; x++)
+			args[x + 4] = outputs[x];
+		args[x + 4] = NULL;
+		start = now();
+		spawn(args, NULL, NULL);
+		rss = wait_all(1);
+		report(y ? "merge-heap" : "merge-table", bench_hash, out_bytes,
+		       words, now() - start, rss);
+	}
+
+	/* End to end over loopback */
+	port = 20000 + getpid() % 20000;
+	args[0] = "worker";
+	for (x = 0; x < nr_workers; x++) {
+		snprintf(ports[2 * x], sizeof(ports[0]), "%d", port + 2 * x);
+		snprintf(ports[2 * x + 1], sizeof(ports[0]), "%d", port + 2 * x + 1);
+		args[1] = ports[2 * x];
+		args[2] = ports[2 * x + 1];
+		args[3] = NULL;
+		spawn(args, NULL, NULL);
+	}
+	wait_for_ports(port, 2 * nr_workers);
+	args[0] = "driver";
+	args[1] = "--hash";
+	args[2] = (char *)hash_function_names[bench_hash];
+	a = 3;
+	if (bench_utf8)
+		args[a++] = "--utf8";
+	args[a++] = corpus_path;
+	for (x = 0; x < nr_workers; x++) {
+		args[a++] = "127.0.0.1";
+		args[a++] = ports[2 * x];
+		args[a++] = ports[2 * x + 1];
+	}
+	args[a] = NULL;
+	start = now();
+	spawn(args, NULL, NULL);
+	rss = wait_all(nr_workers + 1);
+	report("loopback", bench_hash, size, words, now() - start, rss);
+
+	for (x = 0; x < nr_workers; x++) {
+		unlink(chunks[x]);
+		unlink(outputs[x]);
+	}
+	unlink(corpus_path);
+	rmdir(tmp_dir);
+	return 0;
+}
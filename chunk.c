@@ -1,74 +1,143 @@
-/* Simple thing to chunk an input file into a bunch of output files. */
+/* Chunk an input file into a bunch of output files.  Every cut is
+   moved forwards to the next space, so no word is split between two
+   chunks, and the chunks are copied in parallel inside the kernel.
+   With --index, the chunk offsets are also written out, one "start
+   end" line per chunk, for driver --index. */
 #define _GNU_SOURCE
+#include <sys/types.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
 #include <err.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "dwc.h"
+
+struct chunk {
+	pthread_t thread;
+	int input_fd;
+	char *output;
+	off_t start;
+	off_t end;
+};
+
+static void *
+copy_chunk(void *_c)
+{
+	struct chunk *c = _c;
+	off_t off;
+	ssize_t copied;
+	int out;
+	bool use_sendfile;
+
+	out = open(c->output, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+	if (out < 0)
+		err(1, "creating %s", c->output);
+	use_sendfile = false;
+	for (off = c->start; off < c->end; ) {
+		if (!use_sendfile) {
+			copied = copy_file_range(c->input_fd, &off, out, NULL,
+						 c->end - off, 0);
+			/* Not supported between these two files; the
+			   kernel can still do it with sendfile. */
+			if (copied < 0 && (errno == EXDEV || errno == EINVAL ||
+					   errno == ENOSYS || errno == EOPNOTSUPP)) {
+				use_sendfile = true;
+				continue;
+			}
+		} else {
+			copied = sendfile(out, c->input_fd, &off, c->end - off);
+		}
+		if (copied < 0)
+			err(1, "copying to %s", c->output);
+		if (copied == 0)
+			errx(1, "input seemed to shrink while we were reading it?");
+	}
+	if (close(out) < 0)
+		err(1, "closing %s", c->output);
+	return NULL;
+}
 
 int
 main(int argc, char *argv[])
 {
-	char *input = argv[1];
-	int nr_outputs = atoi(argv[2]);
-	char *output_prefix = argv[3];
-	FILE *inp = fopen(input, "r");
-	long file_size;
-	unsigned x;
-	unsigned long chunk_size;
+	char *input;
+	int nr_outputs;
+	char *output_prefix;
+	char *index_file;
+	struct chunk *chunks;
+	struct stat st;
+	FILE *index;
+	off_t cut;
+	int fd;
+	int x;
 
-	if (!inp)
-		err(1, "opening %s", input);
-	if (fseek(inp, 0, SEEK_END) < 0)
-		err(1, "fseeko(%s)", input);
-	file_size = ftell(inp);
-	if (file_size == -1)
-		err(1, "ftell(%s)", input);
-	rewind(inp);
+	index_file = NULL;
+	if (argc > 2 && !strcmp(argv[1], "--index")) {
+		index_file = argv[2];
+		argv += 2;
+		argc -= 2;
+	}
+	if (argc != 4)
+		errx(1, "usage: chunk [--index file] input nr_outputs output_prefix");
+	input = argv[1];
+	nr_outputs = atoi(argv[2]);
+	output_prefix = argv[3];
+	if (nr_outputs < 1)
+		errx(1, "need at least one output");
 
-	chunk_size = file_size / nr_outputs;
-	printf("Chunk size %ld\n", chunk_size);
+	fd = open(input, O_RDONLY);
+	if (fd < 0)
+		err(1, "opening %s", input);
+	if (fstat(fd, &st) < 0)
+		err(1, "stat(%s)", input);
+	printf("Chunk size %lld\n", (long long)(st.st_size / nr_outputs));
 
+	chunks = calloc(nr_outputs, sizeof(chunks[0]));
+	if (!chunks)
+		err(1, "allocating chunks");
 	for (x = 0; x < nr_outputs; x++) {
-		char *output;
-		FILE *out;
-		unsigned long written_this_file;
-		static char buffer[1 << 20];
-		size_t read_this_time;
-		size_t written_this_read;
-		size_t written_this_time;
-		unsigned to_read;
-
-		/* Make sure the last chunk captures the bit which
-		   isn't neatly divisible. */
-		if (x == nr_outputs - 1)
-			chunk_size += file_size % nr_outputs;
-
-		asprintf(&output, "%s_%d", output_prefix, x);
-		out = fopen(output, "w");
-
-		for (written_this_file = 0; written_this_file < chunk_size; written_this_file += read_this_time) {
-			to_read = sizeof(buffer);
-			if (written_this_file + to_read > chunk_size)
-				to_read = chunk_size - written_this_file;
-			read_this_time = fread(buffer, 1, to_read, inp);
-			if (read_this_time == 0) {
-				if (feof(inp))
-					errx(1, "%s seemed to shrink while we were reading it?",
-					     input);
-				err(1, "reading %s", input);
-			}
-			for (written_this_read = 0;
-			     written_this_read < read_this_time;
-			     written_this_read += written_this_time) {
-				written_this_time = fwrite(buffer, 1, read_this_time - written_this_read, out);
-				if (written_this_time == 0)
-					err(1, "writing to %s", output);
-			}
+		if (x == nr_outputs - 1) {
+			cut = st.st_size;
+		} else {
+			cut = st.st_size / nr_outputs * (x + 1);
+			if (x != 0 && cut < chunks[x - 1].end)
+				cut = chunks[x - 1].end;
+			cut = next_word_boundary(fd, cut, st.st_size);
 		}
+		chunks[x].input_fd = fd;
+		chunks[x].start = x == 0 ? 0 : chunks[x - 1].end;
+		chunks[x].end = cut;
+		if (asprintf(&chunks[x].output, "%s_%d", output_prefix, x) < 0)
+			err(1, "asprintf");
+		errno = pthread_create(&chunks[x].thread, NULL, copy_chunk,
+				       &chunks[x]);
+		if (errno)
+			err(1, "creating thread for %s", chunks[x].output);
+	}
+
+	for (x = 0; x < nr_outputs; x++) {
+		errno = pthread_join(chunks[x].thread, NULL);
+		if (errno)
+			err(1, "joining thread for %s", chunks[x].output);
+		printf("Wrote %lld to %s\n", (long long)(chunks[x].end - chunks[x].start),
+		       chunks[x].output);
+	}
 
-		printf("Wrote %ld to %s\n", written_this_file, output);
-		if (fclose(out) == EOF)
-			err(1, "closing %s", output);
-		free(output);
+	if (index_file) {
+		index = fopen(index_file, "w");
+		if (!index)
+			err(1, "creating %s", index_file);
+		for (x = 0; x < nr_outputs; x++)
+			fprintf(index, "%lld %lld\n", (long long)chunks[x].start,
+				(long long)chunks[x].end);
+		if (fclose(index) == EOF)
+			err(1, "writing %s", index_file);
 	}
 
 	return 0;
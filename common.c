@@ -1,105 +1,950 @@
 /* Stuff which is common to both worker and driver */
 #include <sys/fcntl.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
 #include <assert.h>
 #include <err.h>
+#include <pthread.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <stddef.h>
+#include <stdio.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
 
 #include "dwc.h"
 
-struct word * hash_table[NR_HASH_TABLE_SLOTS];
+struct word_table word_table;
 static bool use_bump_malloc;
+/* Where map_snapshot() put the snapshot.  Its words go straight into
+ * the table, so bump_free() has to leave them alone. */
+static const unsigned char *snapshot_base;
+static size_t snapshot_size;
 
-/* Never need to call free() -> use a bump allocator */
-#define ARENA_SIZE (2 << 20)
+__thread struct metrics metrics;
+static struct metrics metrics_total;
+static pthread_mutex_t metrics_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Never need to call free() -> use a bump allocator.  Each thread
+   bumps through its own arenas, which start at ARENA_MIN_SIZE and
+   double each time up to ARENA_MAX_SIZE.  They're aligned to huge
+   pages, and either come from hugetlbfs (MALLOC_HUGETLB) or are
+   offered to transparent huge pages.  With MALLOC_NUMA_LOCAL each
+   arena is bound to the node the thread is running on when it's
+   made, before anything touches it. */
+#define HUGE_PAGE_SIZE (2ul << 20)
+#define ARENA_MIN_SIZE HUGE_PAGE_SIZE
+#define ARENA_MAX_SIZE (64ul << 20)
 struct arena {
-	unsigned used; /* includes header */
-	unsigned pad; /* Keep it 8-byte aligned */
+	struct arena *prev; /* made before this one by the same thread */
+	size_t used; /* includes header */
+	size_t size;
 	unsigned char content[];
 };
 
-static struct arena *current_arena;
+static __thread struct arena *current_arena;
+/* Every arena the thread has, including current_arena and the ones
+ * for big allocations, most recent first */
+static __thread struct arena *arenas;
+static __thread size_t next_arena_size = ARENA_MIN_SIZE;
+/* Shared by every counting thread.  map_huge() can clear
+   MALLOC_HUGETLB under their feet, so it's read and written
+   atomically. */
+static unsigned malloc_flags;
+
+/* Prefer node for [p, p + size).  Only a hint, so failure's fine. */
+static void
+bind_to_local_node(void *p, size_t size)
+{
+	unsigned cpu;
+	unsigned node;
+	unsigned long mask;
+
+	if (syscall(SYS_getcpu, &cpu, &node, NULL) < 0 ||
+	    node >= sizeof(mask) * 8)
+		return;
+	mask = 1ul << node;
+	syscall(SYS_mbind, p, size, MPOL_PREFERRED, &mask, sizeof(mask) * 8, 0);
+}
 
-static struct arena *
-new_arena(void)
+/* A mapping of size bytes, which is a multiple of HUGE_PAGE_SIZE,
+   aligned to HUGE_PAGE_SIZE. */
+static void *
+map_huge(size_t size)
 {
-	struct arena *w;
-	w = mmap(NULL, ARENA_SIZE, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS,
-		 -1, 0);
-	w->used = sizeof(struct arena);
-	return w;
+	unsigned char *p;
+	size_t lead;
+
+	if (__atomic_load_n(&malloc_flags, __ATOMIC_RELAXED) & MALLOC_HUGETLB) {
+		p = mmap(NULL, size, PROT_READ|PROT_WRITE,
+			 MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB, -1, 0);
+		if (p != MAP_FAILED)
+			goto out;
+		/* Pool's empty, or not configured at all.  Only the
+		   thread which turns hugetlbfs off says so. */
+		if (__atomic_fetch_and(&malloc_flags, ~MALLOC_HUGETLB,
+				       __ATOMIC_RELAXED) & MALLOC_HUGETLB)
+			warnx("no hugetlbfs pages, using transparent huge pages");
+	}
+
+	/* Over-map and trim to get the alignment */
+	p = mmap(NULL, size + HUGE_PAGE_SIZE, PROT_READ|PROT_WRITE,
+		 MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+	if (p == MAP_FAILED)
+		err(1, "mapping %zd bytes", size);
+	lead = -(uintptr_t)p & (HUGE_PAGE_SIZE - 1);
+	if (lead)
+		munmap(p, lead);
+	munmap(p + lead + size, HUGE_PAGE_SIZE - lead);
+	p += lead;
+	madvise(p, size, MADV_HUGEPAGE);
+out:
+	if (__atomic_load_n(&malloc_flags, __ATOMIC_RELAXED) & MALLOC_NUMA_LOCAL)
+		bind_to_local_node(p, size);
+	metrics.arena_bytes += size;
+	return p;
 }
 
+static void
+new_arena(size_t needed)
+{
+	struct arena *a;
+	size_t size;
+
+	if (current_arena)
+		metrics.arena_wasted += current_arena->size - current_arena->used;
+	size = next_arena_size;
+	if (next_arena_size < ARENA_MAX_SIZE)
+		next_arena_size *= 2;
+	while (size < needed + sizeof(*a))
+		size *= 2;
+	a = map_huge(size);
+	a->prev = arenas;
+	a->used = sizeof(*a);
+	a->size = size;
+	metrics.arena_wasted += sizeof(*a);
+	current_arena = a;
+	arenas = a;
+}
 
 /* Very simple allocator, on the assumption that you never need to
    call free().  Returns zeroed memory. */
 void *
 bump_malloc(size_t s)
 {
+	size_t rounded;
 	void *res;
+
 	if (use_bump_malloc) {
-		s = (s + 7) & ~7;
-		if (current_arena->used + s > ARENA_SIZE) {
-			current_arena = new_arena();
-			assert(current_arena->used + s <= ARENA_SIZE);
+		rounded = (s + 7) & ~7;
+		if (rounded > ARENA_MAX_SIZE / 4) {
+			/* Big enough to get its own mapping, rather
+			 * than throw away the rest of an arena. */
+			struct arena *a;
+
+			rounded = (rounded + sizeof(*a) + HUGE_PAGE_SIZE - 1) &
+				~(HUGE_PAGE_SIZE - 1);
+			a = map_huge(rounded);
+			a->prev = arenas;
+			a->used = a->size = rounded;
+			arenas = a;
+			res = a->content;
+			rounded -= sizeof(*a);
+			metrics.arena_wasted += sizeof(*a);
+		} else {
+			if (!current_arena ||
+			    current_arena->used + rounded > current_arena->size)
+				new_arena(rounded);
+			res = (void *)current_arena + current_arena->used;
+			current_arena->used += rounded;
 		}
-		res = (void *)current_arena + current_arena->used;
-		current_arena->used += s;
+		metrics.arena_used += s;
+		metrics.arena_wasted += rounded - s;
 	} else {
 		res = calloc(s, 1);
+		if (!res)
+			err(1, "allocating %zd bytes", s);
+		metrics.heap_bytes += s;
 	}
 	return res;
 }
 
+/* Give back something from bump_malloc().  That's only possible when
+   it's really calloc(), but the accounting wants to know either
+   way. */
+void
+bump_free(void *p, size_t s)
+{
+	if (use_bump_malloc)
+		return;
+	if ((const unsigned char *)p >= snapshot_base &&
+	    (const unsigned char *)p < snapshot_base + snapshot_size)
+		return;
+	free(p);
+	metrics.heap_bytes -= s;
+}
+
+/* Give back everything this thread has had from bump_malloc(), all
+   at once.  Only does anything with MALLOC_BUMP; otherwise, it's up
+   to the caller to bump_free() each allocation first. */
+void
+bump_reset(void)
+{
+	struct arena *a;
+
+	while (arenas) {
+		a = arenas;
+		arenas = a->prev;
+		metrics.arena_bytes -= a->size;
+		munmap(a, a->size);
+	}
+	current_arena = NULL;
+	next_arena_size = ARENA_MIN_SIZE;
+}
+
+/* The table is split into 2^bits home cells, plus an overflow area
+   so that a cluster near the top never has to wrap round to the
+   bottom, which would break the sort order.  The very last cell is
+   always kept empty so that probes don't need a bounds check. */
+#define OVERFLOW_CELLS 64
+#define INITIAL_TABLE_BITS 16
+/* Order keys are the slot in the top bits and 32 bits of hash below
+ * it, so they always fit in this many bits. */
+#define KEY_BITS 50
+/* Words arriving in key order can pack part of the table solid long
+   before the table as a whole is full, and then every insert into
+   that part has to shift the rest of it up.  Grow early when that
+   happens, as long as the table isn't already mostly empty. */
+#define LONG_CLUSTER 256
+
+uint64_t
+order_key(uint64_t h)
+{
+	return ((uint64_t)(h % NR_HASH_TABLE_SLOTS) << 32) | (h >> 32);
+}
+
+/* The smallest b with n <= 2^b */
+static unsigned
+bits_for(uint64_t n)
+{
+	unsigned b;
+
+	for (b = 0; b < 64 && (1ull << b) < n; b++)
+		;
+	return b;
+}
+
+/* Each half of the keys goes onto its half of the home cells */
+static void
+set_home_shifts(struct word_table *t)
+{
+	unsigned lo_bits = bits_for(t->focus - t->base);
+	unsigned hi_bits = bits_for((1ull << KEY_BITS) - t->focus);
+
+	t->lo_shift = lo_bits > t->bits - 1 ? lo_bits - (t->bits - 1) : 0;
+	t->hi_shift = hi_bits > t->bits - 1 ? hi_bits - (t->bits - 1) : 0;
+}
+
+/* Until word_table_focus() says otherwise, the home cells are spread
+ * evenly over every possible key */
+static void
+init_word_table(struct word_table *t, unsigned bits)
+{
+	t->nr_cells = (1u << bits) + OVERFLOW_CELLS;
+	t->cells = calloc(t->nr_cells, sizeof(t->cells[0]));
+	if (!t->cells)
+		err(1, "allocating word table with %d cells", t->nr_cells);
+	metrics.table_bytes += t->nr_cells * sizeof(t->cells[0]);
+	t->nr_used = 0;
+	t->bits = bits;
+	t->base = 0;
+	t->focus = 1ull << (KEY_BITS - 1);
+	set_home_shifts(t);
+}
+
+/* Copy everything into a new table with 2^bits home cells.  The old
+   table is already sorted, so each word just goes in the first free
+   cell at or after its home.  Returns false if that runs off the
+   end. */
+static bool
+rebuild_word_table(struct word_table *t, unsigned bits)
+{
+	struct word_table n;
+	unsigned x, idx, next;
+
+	init_word_table(&n, bits);
+	n.base = t->base;
+	n.focus = t->focus;
+	set_home_shifts(&n);
+	next = 0;
+	for (x = 0; x < t->nr_cells; x++) {
+		if (!t->cells[x].word)
+			continue;
+		idx = word_home(&n, t->cells[x].key);
+		if (idx < next)
+			idx = next;
+		if (idx >= n.nr_cells - 1) {
+			free(n.cells);
+			metrics.table_bytes -= n.nr_cells * sizeof(n.cells[0]);
+			return false;
+		}
+		n.cells[idx] = t->cells[x];
+		next = idx + 1;
+	}
+	n.nr_used = t->nr_used;
+	free(t->cells);
+	metrics.table_bytes -= t->nr_cells * sizeof(t->cells[0]);
+	*t = n;
+	return true;
+}
+
+static void
+grow_word_table(struct word_table *t)
+{
+	unsigned bits;
+
+	metrics.table_grows++;
+	bits = t->bits + 1;
+	while (!rebuild_word_table(t, bits))
+		bits++;
+}
+
+/* HASH_LEGACY is the original multiplicative hash, kept for talking
+   to workers from before wire version 3.  Those were all 32-bit
+   builds, so it's done in 32 bits with 4-byte loads whatever this
+   build is, or its slots wouldn't match theirs.  It lets the low bits of
+   each byte pile up in the low bits of the hash, so words which only
+   differ in a character or two, like hex IDs and URLs, land in long
+   clusters.  HASH_MIX runs each eight-byte load through a multiply
+   and xor-shift before folding it in, and finishes with the
+   MurmurHash3 finaliser, so every input bit reaches every output
+   bit.  The loads don't depend on each other, so they pipeline. */
+unsigned hash_function = HASH_MIX;
+uint64_t hash_seed;
+bool tok_utf8;
+const char *const hash_function_names[NR_HASH_FUNCTIONS] = {
+	[HASH_LEGACY] = "legacy",
+	[HASH_MIX] = "mix",
+};
+
+#define MIX_K1 0x9e3779b97f4a7c15ull
+#define MIX_K2 0xbf58476d1ce4e5b9ull
+
+static uint64_t
+hash_legacy(const unsigned char *start, unsigned size)
+{
+	uint32_t h;
+	uint32_t v;
+	unsigned idx;
+
+	h = hash_seed;
+	for (idx = 0; idx + 4 <= size; idx += 4) {
+		memcpy(&v, start + idx, 4);
+		h = v + h * 524287;
+	}
+	for (; idx < size; idx++)
+		h = start[idx] + h * 127;
+	return h;
+}
+
+static inline uint64_t
+mix_block(uint64_t h, uint64_t v)
+{
+	v *= MIX_K2;
+	v ^= v >> 31;
+	return (h ^ v) * MIX_K1;
+}
+
+static uint64_t
+hash_mix(const unsigned char *start, unsigned size)
+{
+	uint64_t h;
+	uint64_t v;
+	unsigned idx;
+
+	h = hash_seed ^ (size * MIX_K1);
+	for (idx = 0; idx + 8 <= size; idx += 8) {
+		memcpy(&v, start + idx, 8);
+		h = mix_block(h, v);
+	}
+	if (idx < size) {
+		v = 0;
+		memcpy(&v, start + idx, size - idx);
+		h = mix_block(h, v);
+	}
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdull;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ull;
+	h ^= h >> 33;
+	return h;
+}
+
+uint64_t
+hash_word(const unsigned char *start, unsigned size)
+{
+	if (hash_function == HASH_LEGACY)
+		return hash_legacy(start, size);
+	return hash_mix(start, size);
+}
+
+unsigned
+parse_hash_function(const char *name)
+{
+	unsigned x;
+
+	for (x = 0; x < NR_HASH_FUNCTIONS; x++)
+		if (!strcmp(name, hash_function_names[x]))
+			return x;
+	errx(1, "unknown hash %s; want legacy or mix", name);
+}
+
+/* The first cell at or after idx which is empty or has a key no
+   smaller than key.  A cell past an empty one has its home past it
+   too, so that's a monotone condition, and can be galloped over
+   rather than walked.  That matters when words arrive in key order,
+   as they do in the driver and in word_table_merge(): each one goes
+   on the end of the cluster before it, and clusters get long. */
+static inline unsigned
+find_key(const struct word_table *t, unsigned idx, uint64_t key)
+{
+	const struct word *cells = t->cells;
+	unsigned lo, hi, mid, step;
+
+	if (!cells[idx].word || cells[idx].key >= key)
+		return idx;
+	/* cells[lo] is below key, and cells[hi] isn't */
+	lo = idx;
+	for (step = 1; ; step *= 2) {
+		hi = lo + step;
+		if (hi >= t->nr_cells - 1) {
+			hi = t->nr_cells - 1;
+			break;
+		}
+		if (!cells[hi].word || cells[hi].key >= key)
+			break;
+		lo = hi;
+	}
+	while (hi - lo > 1) {
+		mid = lo + (hi - lo) / 2;
+		if (!cells[mid].word || cells[mid].key >= key)
+			hi = mid;
+		else
+			lo = mid;
+	}
+	return hi;
+}
+
+/* Cells are kept sorted by order key, and every word sits at or
+   after its home cell with no gaps in between.  Lookups stop as soon
+   as they see a bigger key, and inserts shift the rest of the
+   cluster up by one to make room.  If the word isn't already present
+   then the new cell points at stable_copy if that's non-NULL, or a
+   fresh copy of start otherwise. */
+static int
+word_table_insert(struct word_table *t, uint64_t h,
+		  const unsigned char *start, unsigned size, uint64_t count,
+		  unsigned char *stable_copy)
+{
+	uint64_t key;
+	unsigned idx, end, home;
+	struct word *cells;
+
+	key = order_key(h);
+	if (!t->cells)
+		init_word_table(t, INITIAL_TABLE_BITS);
+	metrics.lookups++;
+retry:
+	cells = t->cells;
+	home = word_home(t, key);
+	idx = find_key(t, home, key);
+	for (; cells[idx].word && cells[idx].key == key; idx++) {
+		if (cells[idx].hash == h &&
+		    cells[idx].len == size &&
+		    !memcmp(cells[idx].word, start, size)) {
+			cells[idx].counter += count;
+			metrics.probes += idx - home;
+			return h % NR_HASH_TABLE_SLOTS;
+		}
+	}
+
+	for (end = idx; cells[end].word; end++)
+		;
+	if (end == t->nr_cells - 1 ||
+	    t->nr_used >= (t->nr_cells - OVERFLOW_CELLS) / 4 * 3 ||
+	    (end - home > LONG_CLUSTER &&
+	     t->nr_used >= (t->nr_cells - OVERFLOW_CELLS) / 8)) {
+		grow_word_table(t);
+		goto retry;
+	}
+	metrics.probes += idx - home;
+	metrics.shifted += end - idx;
+	metrics.new_words++;
+	memmove(cells + idx + 1, cells + idx, (end - idx) * sizeof(cells[0]));
+	cells[idx].key = key;
+	cells[idx].hash = h;
+	cells[idx].counter = count;
+	cells[idx].len = size;
+	if (stable_copy) {
+		cells[idx].word = stable_copy;
+	} else {
+		cells[idx].word = bump_malloc(size + 1);
+		memcpy(cells[idx].word, start, size);
+	}
+	t->nr_used++;
+	return h % NR_HASH_TABLE_SLOTS;
+}
+
+int
+word_table_bump(struct word_table *t, const unsigned char *start,
+		unsigned size, unsigned count)
+{
+	return word_table_insert(t, hash_word(start, size), start, size,
+				 count, NULL);
+}
+
+/* Like word_table_bump(), for when the caller already has the hash */
+int
+word_table_add(struct word_table *t, uint64_t h,
+	       const unsigned char *start, unsigned size, uint64_t count)
+{
+	return word_table_insert(t, h, start, size, count, NULL);
+}
+
 int
 bump_word_counter(const unsigned char *start, unsigned size,
 		  unsigned count)
 {
-	unsigned long h;
-	int idx;
-	struct word **pprev, *cursor;
+	return word_table_bump(&word_table, start, size, count);
+}
 
-	h = 0;
-	for (idx = 0; idx < size / sizeof(unsigned long); idx++)
-		h = ((unsigned long *)start)[idx] + h * 524287;
-	for (idx = size & ~(sizeof(unsigned long) - 1); idx < size; idx++)
-		h = start[idx] + h * 127;
+/* Add all of src's counts into dst and release src's cells.  dst
+   takes over the word strings, which must therefore outlive it. */
+void
+word_table_merge(struct word_table *dst, struct word_table *src)
+{
+	struct word *w;
+
+	for_each_word(src, w)
+		word_table_insert(dst, w->hash, w->word, w->len, w->counter,
+				  w->word);
+	free(src->cells);
+	metrics.table_bytes -= src->nr_cells * sizeof(src->cells[0]);
+	memset(src, 0, sizeof(*src));
+}
+
+/* Where to start walking the table to find the words in slot and
+   later.  Every word before it is in an earlier slot. */
+struct word *
+word_table_seek(const struct word_table *t, int slot)
+{
+	uint64_t key = (uint64_t)slot << 32;
+
+	if (!t->cells)
+		return NULL;
+	return t->cells + find_key(t, word_home(t, key), key);
+}
+
+/* Remove every word in slot last_slot or earlier, passing it to fn
+   first.  fn is responsible for releasing w->word. */
+void
+word_table_expire(struct word_table *t, int last_slot,
+		  void (*fn)(struct word *w))
+{
+	uint64_t limit = (uint64_t)(last_slot + 1) << 32;
+	unsigned x, idx, next;
+
+	if (!t->cells)
+		return;
+	for (x = 0; !t->cells[x].word || t->cells[x].key < limit; x++) {
+		if (x == t->nr_cells - 1)
+			return;
+		if (t->cells[x].word) {
+			fn(&t->cells[x]);
+			t->cells[x].word = NULL;
+			t->nr_used--;
+		}
+	}
+
+	/* Everything below x is now empty, but the cluster starting
+	   at x might have been pushed up past its home by the words
+	   we just removed.  Slide it back down. */
+	next = 0;
+	for (; t->cells[x].word; x++) {
+		idx = word_home(t, t->cells[x].key);
+		if (idx < next)
+			idx = next;
+		if (idx != x) {
+			t->cells[idx] = t->cells[x];
+			t->cells[x].word = NULL;
+		}
+		next = idx + 1;
+	}
+}
+
+/* Nearly every key added from now on will be in slots lo to hi, and
+   none will be before lo, so give those slots half the home cells.
+   Spread evenly over the whole key space, as they are to start with,
+   keys which only ever arrive in a narrow band of slots would all be
+   squeezed into that band's share of the table, which would be one
+   long cluster.  That's what the driver's table merge does, with its
+   window of slots past the frontier.  Keys outside lo to hi still
+   work, but share the other half between them. */
+void
+word_table_focus(struct word_table *t, int lo, int hi)
+{
+	unsigned bits;
+
+	if (!t->cells)
+		init_word_table(t, INITIAL_TABLE_BITS);
+	t->base = (uint64_t)lo << 32;
+	t->focus = (uint64_t)(hi + 1) << 32;
+	for (bits = t->bits; !rebuild_word_table(t, bits); bits++)
+		;
+}
+
+const struct snapshot_header *
+map_snapshot(const char *path)
+{
+	const struct snapshot_header *s;
+	struct stat st;
+	void *p;
+	int fd;
+
+	assert(!snapshot_base);
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		err(1, "opening %s", path);
+	if (fstat(fd, &st) < 0)
+		err(1, "stat %s", path);
+	if (st.st_size < sizeof(*s))
+		errx(1, "%s is too short to be a snapshot", path);
+	p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (p == MAP_FAILED)
+		err(1, "mapping %s", path);
+	close(fd);
+	s = p;
+	if (s->magic != SNAPSHOT_MAGIC)
+		errx(1, "%s isn't a snapshot", path);
+	if (s->size != st.st_size)
+		errx(1, "%s should be %llu bytes, but is %llu", path,
+		     (unsigned long long)s->size,
+		     (unsigned long long)st.st_size);
+	if (s->hash_function >= NR_HASH_FUNCTIONS)
+		errx(1, "%s uses unknown hash function %d", path,
+		     s->hash_function);
+	snapshot_base = p;
+	snapshot_size = st.st_size;
+	return s;
+}
+
+/* Decode the snapshot entry at p into w, and return where the next
+ * one starts */
+static const unsigned char *
+snapshot_entry(const unsigned char *p, const unsigned char *end,
+	       struct word *w)
+{
+	uint32_t len;
+
+	if (end - p < SNAPSHOT_ENTRY_HEADER)
+		errx(1, "snapshot ends in the middle of an entry");
+	memcpy(&w->counter, p, 8);
+	memcpy(&w->hash, p + 8, 8);
+	memcpy(&len, p + 16, 4);
+	p += SNAPSHOT_ENTRY_HEADER;
+	if (end - p < len)
+		errx(1, "snapshot ends in the middle of a word");
+	w->key = order_key(w->hash);
+	w->word = (unsigned char *)p;
+	w->len = len;
+	return p + len;
+}
+
+/* Put the words in slots lo up to hi from snapshot s into t, which
+   has to be empty.  The words stay where they are in the mapping,
+   and since they're already in order the cells can be laid out in
+   one pass, as rebuild_word_table() does, with no hashing or
+   shifting.  The driver can write a boundary word out of order if
+   its slot has already gone out, so anything which doesn't fit the
+   order is inserted properly afterwards. */
+void
+word_table_load(struct word_table *t, const struct snapshot_header *s,
+		int lo, int hi)
+{
+	const unsigned char *start = (const unsigned char *)(s + 1);
+	const unsigned char *end = (const unsigned char *)s + s->size;
+	const unsigned char *p;
+	uint64_t nr_words, wanted, max_key;
+	unsigned bits, idx, next;
+	bool late;
+	struct word w;
+
+	if (s->hash_function != hash_function || s->hash_seed != hash_seed)
+		errx(1, "snapshot was saved with %s, seed %llx, but we're using %s, seed %llx",
+		     hash_function_names[s->hash_function],
+		     (unsigned long long)s->hash_seed,
+		     hash_function_names[hash_function],
+		     (unsigned long long)hash_seed);
+	if (s->utf8 != tok_utf8)
+		errx(1, "snapshot was %s UTF-8, but this run %s",
+		     s->utf8 ? "counted as" : "not counted as",
+		     tok_utf8 ? "is" : "isn't");
+	assert(!t->cells);
 
-	idx = h % NR_HASH_TABLE_SLOTS;
-	pprev = &hash_table[idx];
-	while (*pprev) {
-		cursor = *pprev;
-		if (cursor->hash == h &&
-		    cursor->len == size &&
-		    !memcmp(cursor->word, start, size)) {
-			*pprev = cursor->next;
-			cursor->next = hash_table[idx];
-			hash_table[idx] = cursor;
-			cursor->counter += count;
-			return idx;
+	nr_words = wanted = 0;
+	for (p = start; p < end; nr_words++) {
+		p = snapshot_entry(p, end, &w);
+		if (word_slot(&w) >= lo && word_slot(&w) < hi)
+			wanted++;
+	}
+	if (nr_words != s->nr_words)
+		errx(1, "snapshot should have %llu words, but has %llu",
+		     (unsigned long long)s->nr_words,
+		     (unsigned long long)nr_words);
+
+	/* Leave room for about as many again before it has to grow */
+	for (bits = INITIAL_TABLE_BITS; wanted > (1ull << bits) / 8 * 3; bits++)
+		;
+retry:
+	init_word_table(t, bits);
+	next = 0;
+	max_key = 0;
+	late = false;
+	for (p = start; p < end; ) {
+		p = snapshot_entry(p, end, &w);
+		if (word_slot(&w) < lo || word_slot(&w) >= hi)
+			continue;
+		if (w.key < max_key) {
+			late = true;
+			continue;
+		}
+		max_key = w.key;
+		idx = word_home(t, w.key);
+		if (idx < next)
+			idx = next;
+		if (idx >= t->nr_cells - 1) {
+			free(t->cells);
+			metrics.table_bytes -= t->nr_cells * sizeof(t->cells[0]);
+			bits++;
+			goto retry;
 		}
-		pprev = &cursor->next;
+		t->cells[idx] = w;
+		t->nr_used++;
+		next = idx + 1;
 	}
+	if (!late)
+		return;
+
+	max_key = 0;
+	for (p = start; p < end; ) {
+		p = snapshot_entry(p, end, &w);
+		if (word_slot(&w) < lo || word_slot(&w) >= hi)
+			continue;
+		if (w.key >= max_key)
+			max_key = w.key;
+		else
+			word_table_insert(t, w.hash, w.word, w.len, w.counter,
+					  w.word);
+	}
+}
+
+struct snapshot_writer {
+	FILE *f;
+	char *path;
+	char *tmp_path;
+	struct snapshot_header header;
+};
+
+/* Start writing a snapshot to path.  It goes to a temporary file
+   next to it until snapshot_finish(), so a run can save over the
+   snapshot it loaded, and one which dies part way through doesn't
+   leave half a snapshot behind.  Words have to be added in order key
+   order, give or take the driver's late boundary words. */
+struct snapshot_writer *
+snapshot_create(const char *path)
+{
+	struct snapshot_writer *sw;
+	int fd;
+
+	sw = calloc(1, sizeof(*sw));
+	if (!sw)
+		err(1, "allocating snapshot writer");
+	sw->path = strdup(path);
+	sw->tmp_path = malloc(strlen(path) + 8);
+	if (!sw->path || !sw->tmp_path)
+		err(1, "allocating snapshot path");
+	sprintf(sw->tmp_path, "%s.XXXXXX", path);
+	fd = mkstemp(sw->tmp_path);
+	if (fd < 0)
+		err(1, "creating %s", sw->tmp_path);
+	if (fchmod(fd, 0644) < 0)
+		err(1, "chmod %s", sw->tmp_path);
+	sw->f = fdopen(fd, "w");
+	if (!sw->f)
+		err(1, "fdopen %s", sw->tmp_path);
+	sw->header.magic = SNAPSHOT_MAGIC;
+	sw->header.size = sizeof(sw->header);
+	/* The real header goes in at the end */
+	fwrite(&sw->header, sizeof(sw->header), 1, sw->f);
+	return sw;
+}
 
-	cursor = bump_malloc(sizeof(struct word) + size);
-	cursor->hash = h;
-	cursor->next = hash_table[idx];
-	cursor->counter = count;
-	cursor->len = size;
-	memcpy(cursor->word, start, size);
-	hash_table[idx] = cursor;
-	return idx;
+void
+snapshot_add(struct snapshot_writer *sw, const struct word *w)
+{
+	uint32_t len = w->len;
+
+	fwrite(&w->counter, 8, 1, sw->f);
+	fwrite(&w->hash, 8, 1, sw->f);
+	fwrite(&len, 4, 1, sw->f);
+	fwrite(w->word, 1, w->len, sw->f);
+	sw->header.nr_words++;
+	sw->header.size += SNAPSHOT_ENTRY_HEADER + w->len;
+}
+
+void
+snapshot_finish(struct snapshot_writer *sw)
+{
+	sw->header.hash_function = hash_function;
+	sw->header.hash_seed = hash_seed;
+	sw->header.utf8 = tok_utf8;
+	if (fseek(sw->f, 0, SEEK_SET) < 0)
+		err(1, "seeking in %s", sw->tmp_path);
+	fwrite(&sw->header, sizeof(sw->header), 1, sw->f);
+	if (fflush(sw->f) == EOF || ferror(sw->f))
+		err(1, "writing %s", sw->tmp_path);
+	if (fsync(fileno(sw->f)) < 0)
+		err(1, "syncing %s", sw->tmp_path);
+	if (fclose(sw->f) == EOF)
+		err(1, "closing %s", sw->tmp_path);
+	if (rename(sw->tmp_path, sw->path) < 0)
+		err(1, "renaming %s to %s", sw->tmp_path, sw->path);
+	free(sw->path);
+	free(sw->tmp_path);
+	free(sw);
+}
+
+void
+init_malloc(unsigned flags)
+{
+	use_bump_malloc = flags & MALLOC_BUMP;
+	malloc_flags = flags;
 }
 
+/* Add this thread's counters into the process totals, and start it
+   again from zero. */
 void
-init_malloc(bool use_bump)
+metrics_flush(void)
 {
-	use_bump_malloc = use_bump;
-	if (use_bump)
-		current_arena = new_arena();
+	pthread_mutex_lock(&metrics_lock);
+	metrics_total.bytes_received += metrics.bytes_received;
+	metrics_total.bytes_sent += metrics.bytes_sent;
+	metrics_total.lookups += metrics.lookups;
+	metrics_total.new_words += metrics.new_words;
+	metrics_total.probes += metrics.probes;
+	metrics_total.shifted += metrics.shifted;
+	metrics_total.table_grows += metrics.table_grows;
+	metrics_total.arena_bytes += metrics.arena_bytes;
+	metrics_total.arena_used += metrics.arena_used;
+	metrics_total.arena_wasted += metrics.arena_wasted;
+	metrics_total.heap_bytes += metrics.heap_bytes;
+	metrics_total.table_bytes += metrics.table_bytes;
+	pthread_mutex_unlock(&metrics_lock);
+	memset(&metrics, 0, sizeof(metrics));
+}
+
+/* The totals so far, including the calling thread's */
+void
+metrics_print(FILE *f)
+{
+	metrics_flush();
+	fprintf(f, "\"bytes_received\": %llu, \"bytes_sent\": %llu, "
+		"\"lookups\": %llu, \"new_words\": %llu, \"probes\": %llu, "
+		"\"shifted\": %llu, \"table_grows\": %llu, "
+		"\"arena_bytes\": %llu, \"arena_used\": %llu, "
+		"\"arena_wasted\": %llu, \"heap_bytes\": %llu, "
+		"\"table_bytes\": %llu",
+		(unsigned long long)metrics_total.bytes_received,
+		(unsigned long long)metrics_total.bytes_sent,
+		(unsigned long long)metrics_total.lookups,
+		(unsigned long long)metrics_total.new_words,
+		(unsigned long long)metrics_total.probes,
+		(unsigned long long)metrics_total.shifted,
+		(unsigned long long)metrics_total.table_grows,
+		(unsigned long long)metrics_total.arena_bytes,
+		(unsigned long long)metrics_total.arena_used,
+		(unsigned long long)metrics_total.arena_wasted,
+		(unsigned long long)metrics_total.heap_bytes,
+		(unsigned long long)metrics_total.table_bytes);
+}
+
+uint64_t
+monotonic_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/* Turn a --encoding argument into WIRE_* flags */
+uint32_t
+parse_wire_encoding(const char *name)
+{
+	if (!strcmp(name, "plain"))
+		return 0;
+	if (!strcmp(name, "compact"))
+		return WIRE_COMPACT;
+	errx(1, "unknown encoding %s; want plain or compact", name);
+}
+
+/* And a --compress argument: none, deflate, or deflate:level */
+uint32_t
+parse_wire_compression(const char *name)
+{
+	int level;
+
+	if (!strcmp(name, "none"))
+		return 0;
+	if (!strcmp(name, "deflate"))
+		return WIRE_DEFLATE | (1 << WIRE_DEFLATE_LEVEL_SHIFT);
+	if (!strncmp(name, "deflate:", 8)) {
+		level = atoi(name + 8);
+		if (level < 1 || level > 9)
+			errx(1, "deflate level must be between 1 and 9");
+		return WIRE_DEFLATE | (level << WIRE_DEFLATE_LEVEL_SHIFT);
+	}
+	errx(1, "unknown compression %s; want none, deflate or deflate:level",
+	     name);
+}
+
+/* The first ASCII space at or after off in a file of the given
+   size, or the end of the file if there isn't one.  That's a word
+   boundary whether or not the tokenizer's in UTF-8 mode. */
+off_t
+next_word_boundary(int fd, off_t off, off_t size)
+{
+	unsigned char buf[4096];
+	ssize_t r;
+	ssize_t x;
+
+	while (off < size) {
+		r = pread(fd, buf, sizeof(buf), off);
+		if (r < 0)
+			err(1, "reading input");
+		if (r == 0)
+			break;
+		for (x = 0; x < r; x++) {
+			if (is_space(buf[x]) && buf[x] < 0x80)
+				return off + x;
+		}
+		off += r;
+	}
+	return size;
 }
 
 void
@@ -1,28 +1,60 @@
 /* Driver process */
 #include <sys/types.h>
 #include <sys/fcntl.h>
+#include <sys/mman.h>
 #include <sys/sendfile.h>
 #include <sys/stat.h>
-#include <sys/time.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
 #include <arpa/inet.h>
+#include <linux/io_uring.h>
 #include <assert.h>
 #include <err.h>
+#include <errno.h>
+#include <limits.h>
 #include <poll.h>
-#include <malloc.h>
+#include <pthread.h>
+#include <stdbool.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
+#include <zlib.h>
 
 #include "dwc.h"
 
-/* Try to stay below 512MB */
-#define TARGET_MAX_HEAP_SIZE (512 << 20)
-/* Throttle fast workers if we remain above 256MB after a GC pass. */
-#define THROTTLE_HEAP_SIZE (256 << 20)
+/* How many slots past the slowest worker the others can get with the
+ * table merge, unless --window says otherwise */
+#define DEFAULT_WINDOW 16384
+
+static enum { MERGE_TABLE, MERGE_HEAP } merge_engine;
+static enum { LOOP_POLL, LOOP_URING } driver_loop;
+/* Work-queue mode: how big to make the blocks, and where the next
+ * one starts. */
+static off_t block_size;
+static off_t next_block;
+static int wire_version = WIRE_VERSION;
+static uint32_t wire_flags = WIRE_WIDE_COUNTS;
+/* Set once we know which hash everybody's using.  That's from the
+ * start when we're telling the workers, but offline it's whatever
+ * the first stream turns out to have used. */
+static bool hash_agreed;
+/* Likewise WIRE_UTF8 */
+static bool tokenizer_agreed;
+/* Words which straddle chunk boundaries, for the heap merge */
+static struct word_table boundary_words;
+
+/* --partition r/n: we're the reducer for slots partition_lo up to
+ * partition_hi, and the workers send us just those on their results
+ * port plus r.  Reducer 0 also sends the workers their input. */
+static int partition;
+static int nr_partitions = 1;
+static int partition_lo;
+static int partition_hi = NR_HASH_TABLE_SLOTS;
 
 /* How much of the hash table have we GC'd? */
 static int last_gced_hash_slot = -1;
+static int window = DEFAULT_WINDOW;
 
 static double now(void);
 
@@ -35,24 +67,56 @@ connect_to_worker(const char *ip, const char *to_worker_port,
 		  int *from_worker_fd)
 {
 	struct sockaddr_in sin;
+	unsigned char buf[WIRE_HEADER_V3_SIZE];
+	struct wire_header hello;
+	uint32_t credit;
 
 	memset(&sin, 0, sizeof(sin));
 	sin.sin_family = AF_INET;
 	inet_aton(ip, &sin.sin_addr);
-	*to_worker_fd = socket(AF_INET, SOCK_STREAM, 0);
-	if (*to_worker_fd < 0)
-		err(1, "sock()");
-	sin.sin_port = htons(atoi(to_worker_port));
-	if (connect(*to_worker_fd, (struct sockaddr *)&sin, sizeof(sin)) < 0)
-		err(1, "connect to send to worker %s:%s", ip, to_worker_port);
-	sin.sin_port = htons(atoi(from_worker_port));
+	if (partition == 0) {
+		*to_worker_fd = socket(AF_INET, SOCK_STREAM, 0);
+		if (*to_worker_fd < 0)
+			err(1, "sock()");
+		sin.sin_port = htons(atoi(to_worker_port));
+		if (connect(*to_worker_fd, (struct sockaddr *)&sin, sizeof(sin)) < 0)
+			err(1, "connect to send to worker %s:%s", ip, to_worker_port);
+		set_nonblock(*to_worker_fd);
+	} else {
+		*to_worker_fd = -1;
+	}
+	sin.sin_port = htons(atoi(from_worker_port) + partition);
 	*from_worker_fd = socket(AF_INET, SOCK_STREAM, 0);
 	if (*from_worker_fd < 0)
 		err(1, "sock2()");
 	if (connect(*from_worker_fd, (struct sockaddr *)&sin, sizeof(sin)) < 0)
-		err(1, "connect to receive from worker %s:%s", ip, from_worker_port);
+		err(1, "connect to receive from worker %s:%d", ip,
+		    atoi(from_worker_port) + partition);
+
+	/* Tell it what wire version we want.  The socket's brand new,
+	   so this can't block.  Workers from before version 2 don't
+	   know to read this, and would reset the connection by
+	   closing it with the hello still unread, so --wire 1 doesn't
+	   send one. */
+	if (wire_version < 2) {
+		set_nonblock(*from_worker_fd);
+		return;
+	}
+	hello.magic = WIRE_MAGIC;
+	hello.version = wire_version;
+	hello.flags = wire_flags;
+	hello.hash_function = hash_function;
+	hello.hash_seed = hash_seed;
+	put_wire_header(buf, &hello);
+	if (write(*from_worker_fd, buf, wire_header_size(wire_version)) !=
+	    wire_header_size(wire_version))
+		err(1, "sending wire version to worker %s:%s", ip, from_worker_port);
+	if (wire_flags & WIRE_CREDIT) {
+		credit = partition_lo + window - 1;
+		if (write(*from_worker_fd, &credit, 4) != 4)
+			err(1, "sending credit to worker %s:%s", ip, from_worker_port);
+	}
 
-	set_nonblock(*to_worker_fd);
 	set_nonblock(*from_worker_fd);
 }
 
@@ -63,8 +127,17 @@ struct worker {
 	off_t send_offset;
 	off_t end_of_chunk;
 
+	/* Work-queue mode: blocks asked for but not yet started, and
+	 * the length which goes out in front of the current one. */
+	unsigned block_requests;
+	uint32_t block_header;
+	unsigned block_header_sent;
+
 	int finished_hash_entries;
 
+	int wire_version; /* 0 until we've seen the start of the stream */
+	uint32_t wire_flags;
+
 	/* RX machine */
 #define RX_BUFFER_SIZE (1 << 20)
 #define MIN_READ_SIZE (64 << 10)
@@ -72,93 +145,387 @@ struct worker {
 	char *prefix_string;
 	char *suffix_string;
 
+	/* Strings which are too big for rx_buffer get copied out a
+	 * piece at a time. */
 	char *current_word;
 	int current_word_offset;
 	int current_word_len;
-	int current_word_count;
+	uint64_t current_word_count;
+	uint64_t current_word_hash;
+
+	/* The entry peek_entry() last found, until it's consumed */
+	unsigned entry_size;
+	bool entry_in_buffer;
+	char *slow_word;
 
 	int finished;
+	/* The last slot it's allowed to send.  Workers which do
+	 * WIRE_CREDIT know that; for the rest, rx_throttled stops us
+	 * reading once they get there. */
+	int credit;
+	bool rx_throttled;
+
+	/* WIRE_DEFLATE streams: reads go into zbuf, and get inflated
+	 * into rx_buffer as there's room for them.  zbuf has to be
+	 * able to take everything read along with the header. */
+#define ZBUF_SIZE RX_BUFFER_SIZE
+	bool inflating;
+	z_stream inflater;
+	unsigned char *zbuf;
+
+	/* io_uring loop: what we've got in flight for this worker.
+	 * Input goes through splice_pipe, which holds in_pipe bytes
+	 * that haven't reached the worker yet. */
+	bool rx_in_flight;
+	int splices_in_flight;
+	int splice_pipe[2];
+	unsigned in_pipe;
+
+	/* Heap merge engine: the next entry from this worker which
+	 * hasn't been merged yet. */
+	enum { HEAD_NONE, HEAD_READY, HEAD_EOF } head_state;
+	struct word head;
 
 	unsigned rx_buffer_avail;
+	/* For --metrics.  Times are monotonic_ns(); the throttled
+	 * total doesn't include the current spell, which started at
+	 * throttled_since. */
+	uint64_t bytes_sent;
+	uint64_t bytes_received;
+	uint64_t throttled_ns;
+	uint64_t throttled_since;
+	uint64_t first_result_ns;
+	uint64_t finished_ns;
+
 	unsigned rx_buffer_used;
 	unsigned char rx_buffer[RX_BUFFER_SIZE];
 };
 
+/* get_varint() on a worker's stream, where a malformed varint can
+ * only mean the stream's broken */
+static bool
+get_rx_varint(const unsigned char **p, const unsigned char *end, uint64_t *v)
+{
+	switch (get_varint(p, end, v)) {
+	case VARINT_OK:
+		return true;
+	case VARINT_SHORT:
+		return false;
+	default:
+		errx(1, "malformed varint from worker");
+	}
+}
+
+static void
+compact_rx_buffer(struct worker *w)
+{
+	if (RX_BUFFER_SIZE - w->rx_buffer_avail >= MIN_READ_SIZE)
+		return;
+	/* A head entry waiting in the heap moves along with the rest
+	   of the buffer */
+	if (w->head_state == HEAD_READY && w->entry_in_buffer)
+		w->head.word -= w->rx_buffer_used;
+	memmove(w->rx_buffer,
+		w->rx_buffer + w->rx_buffer_used,
+		w->rx_buffer_avail - w->rx_buffer_used);
+	w->rx_buffer_avail -= w->rx_buffer_used;
+	w->rx_buffer_used = 0;
+}
+
+/* How much we could read from the worker's socket right now */
+static unsigned
+rx_room(const struct worker *w)
+{
+	if (w->inflating)
+		return ZBUF_SIZE - w->inflater.avail_in;
+	return RX_BUFFER_SIZE - w->rx_buffer_avail + w->rx_buffer_used;
+}
+
+/* Inflate whatever's sitting in zbuf into rx_buffer.  Returns true if
+   that got anywhere, in which case the caller should have another go
+   at parsing. */
+static bool
+inflate_rx(struct worker *w)
+{
+	unsigned avail_in;
+	unsigned avail_out;
+	int r;
+
+	if (!w->inflating || !w->inflater.avail_in)
+		return false;
+	compact_rx_buffer(w);
+	if (w->rx_buffer_avail == RX_BUFFER_SIZE)
+		return false;
+	avail_in = w->inflater.avail_in;
+	avail_out = w->rx_buffer_avail;
+	w->inflater.next_out = w->rx_buffer + w->rx_buffer_avail;
+	w->inflater.avail_out = RX_BUFFER_SIZE - w->rx_buffer_avail;
+	r = inflate(&w->inflater, Z_NO_FLUSH);
+	if (r == Z_STREAM_END && w->inflater.avail_in)
+		errx(1, "junk after end of compressed stream");
+	if (r != Z_OK && r != Z_STREAM_END && r != Z_BUF_ERROR)
+		errx(1, "inflating worker stream: %s",
+		     w->inflater.msg ? w->inflater.msg : "bad data");
+	w->rx_buffer_avail = RX_BUFFER_SIZE - w->inflater.avail_out;
+	return w->inflater.avail_in != avail_in || w->rx_buffer_avail != avail_out;
+}
+
 static char *
 read_string(struct worker *w)
 {
 	int size;
 	char *res;
-
-	if (w->rx_buffer_used + 4 > w->rx_buffer_avail)
-		return NULL;
+	int to_copy;
 
 	if (!w->current_word) {
-		size = *(unsigned *)(w->rx_buffer + w->rx_buffer_used);
+		if (w->wire_flags & WIRE_COMPACT) {
+			const unsigned char *p = w->rx_buffer + w->rx_buffer_used;
+			uint64_t v;
+
+			if (!get_rx_varint(&p, w->rx_buffer + w->rx_buffer_avail, &v))
+				return NULL;
+			if (v > INT_MAX)
+				errx(1, "worker sent a %llu byte word",
+				     (unsigned long long)v);
+			size = v;
+			w->rx_buffer_used = p - w->rx_buffer;
+		} else {
+			if (w->rx_buffer_used + 4 > w->rx_buffer_avail)
+				return NULL;
+			size = *(unsigned *)(w->rx_buffer + w->rx_buffer_used);
+			w->rx_buffer_used += 4;
+		}
 		if (size > RX_BUFFER_SIZE - 1000)
 			DBG("Enormous string: %d\n", size);
 		w->current_word = malloc(size + 1);
 		w->current_word_offset = 0;
 		w->current_word_len = size;
-		w->rx_buffer_used += 4;
 	}
 
-	if (w->rx_buffer_used < w->rx_buffer_avail) {
-		int to_copy;
-		to_copy = w->current_word_len - w->current_word_offset;
-		if (w->rx_buffer_used + to_copy > w->rx_buffer_avail)
-			to_copy = w->rx_buffer_avail - w->rx_buffer_used;
-		memcpy(w->current_word + w->current_word_offset,
-		       w->rx_buffer + w->rx_buffer_used,
-		       to_copy);
-		w->current_word_offset += to_copy;
-		w->rx_buffer_used += to_copy;
-		if (w->current_word_offset == w->current_word_len) {
-			w->current_word[w->current_word_offset] = 0;
-			res = w->current_word;
-			w->current_word = NULL;
-			return res;
-		}
+	to_copy = w->current_word_len - w->current_word_offset;
+	if (w->rx_buffer_used + to_copy > w->rx_buffer_avail)
+		to_copy = w->rx_buffer_avail - w->rx_buffer_used;
+	memcpy(w->current_word + w->current_word_offset,
+	       w->rx_buffer + w->rx_buffer_used,
+	       to_copy);
+	w->current_word_offset += to_copy;
+	w->rx_buffer_used += to_copy;
+	if (w->current_word_offset == w->current_word_len) {
+		w->current_word[w->current_word_offset] = 0;
+		res = w->current_word;
+		w->current_word = NULL;
+		return res;
 	}
 
 	return NULL;
 }
 
+/* The two halves go through the same tokenizer as the rest of the
+   input did in the workers.  In UTF-8 mode the workers only cut at
+   ASCII spaces, so there can be several words in there, or none. */
 static void
 process_split_string(char *prefix, char *suffix, int worker1, int worker2)
 {
-	int plen = strlen(prefix);
-	int slen = strlen(suffix);
-	int total_len = plen + slen;
+	unsigned plen = strlen(prefix);
+	unsigned slen = strlen(suffix);
+	unsigned total_len = plen + slen;
 	unsigned char *buf;
+	unsigned char *word;
+	unsigned pos;
+	unsigned len;
 	int idx;
 
-	buf = alloca(total_len+1);
+	buf = malloc(total_len + 1 + TOKENIZE_PAD);
+	word = malloc(TOKENIZE_OUT_SIZE(total_len));
+	if (!buf || !word)
+		err(1, "allocating %d byte split string", total_len);
 	memcpy(buf, prefix, plen);
-	memcpy(buf + plen, suffix, slen + 1);
+	memcpy(buf + plen, suffix, slen);
 
-	idx = bump_word_counter(buf, total_len, 1);
-	DBG("worker %d:%d produced split string in bucket %d\n",
-	    worker1, worker2, idx);
+	pos = 0;
+	while (1) {
+		buf[total_len] = 'X';
+		pos = tok_skip_spaces(buf, pos);
+		if (pos >= total_len)
+			break;
+		buf[total_len] = ' ';
+		pos = tok_fold_word(buf, pos, word, &len);
+
+		/* Every reducer sees every boundary, but only one of
+		   them gets to count each word. */
+		if (nr_partitions > 1) {
+			idx = hash_word(word, len) % NR_HASH_TABLE_SLOTS;
+			if (idx < partition_lo || idx >= partition_hi)
+				continue;
+		}
+
+		idx = word_table_bump(merge_engine == MERGE_HEAP ? &boundary_words : &word_table,
+				      word, len, 1);
+		DBG("worker %d:%d produced split string in bucket %d\n",
+		    worker1, worker2, idx);
+	}
+	free(buf);
+	free(word);
 }
 
-static int
-process_word_entry(struct worker *w, int wid)
+/* Compact encoding: varint count, then a varint length and the word.
+ * There's no hash on the wire, so the word gets hashed here. */
+static bool
+peek_compact_entry(struct worker *w, struct word *e)
 {
-	int idx;
+	const unsigned char *start, *p, *end;
+	uint64_t count, len;
+	unsigned header_size;
 	char *word;
 
-	if (w->rx_buffer_used + 8 > w->rx_buffer_avail)
-		return 0;
-	if (w->current_word_count == 0) {
-		w->current_word_count = *(unsigned *)(w->rx_buffer + w->rx_buffer_used);
-		assert(w->current_word_count > 0);
-		w->rx_buffer_used += 4;
+	if (!w->current_word) {
+		start = p = w->rx_buffer + w->rx_buffer_used;
+		end = w->rx_buffer + w->rx_buffer_avail;
+		if (!get_rx_varint(&p, end, &count))
+			return false;
+		header_size = p - start;
+		if (!get_rx_varint(&p, end, &len))
+			return false;
+		e->counter = count;
+		assert(e->counter > 0);
+		if (len <= end - p) {
+			e->word = (unsigned char *)p;
+			e->len = len;
+			e->hash = hash_word(e->word, e->len);
+			e->key = order_key(e->hash);
+			w->entry_in_buffer = true;
+			w->entry_size = p + len - start;
+			return true;
+		}
+		if (p - start + len <= RX_BUFFER_SIZE - MIN_READ_SIZE)
+			return false;
+
+		/* Leave the length for read_string() */
+		w->current_word_count = count;
+		w->rx_buffer_used += header_size;
+	}
+
+	word = read_string(w);
+	if (!word)
+		return false;
+	e->counter = w->current_word_count;
+	e->word = (unsigned char *)word;
+	e->len = w->current_word_len;
+	e->hash = hash_word(e->word, e->len);
+	e->key = order_key(e->hash);
+	w->slow_word = word;
+	w->entry_in_buffer = false;
+	w->entry_size = 0;
+	return true;
+}
+
+/* Find the next (count, word) entry in w's RX buffer, if all of it
+   has arrived.  Normally it's parsed in place, e->word points into
+   rx_buffer, and nothing is consumed until consume_entry().  An entry
+   which straddles the end of what we've received so far just waits
+   for do_rx() to compact the buffer and read the rest.  Only one
+   which could never fit in rx_buffer is copied out piecemeal by
+   read_string().  Don't peek again without consuming in between. */
+static bool
+peek_entry(struct worker *w, struct word *e)
+{
+	unsigned count_size;
+	unsigned header_size;
+	unsigned avail;
+	unsigned len;
+	const unsigned char *p;
+	char *word;
+
+	if (w->wire_flags & WIRE_COMPACT)
+		return peek_compact_entry(w, e);
+
+	if (!w->current_word) {
+		p = w->rx_buffer + w->rx_buffer_used;
+		avail = w->rx_buffer_avail - w->rx_buffer_used;
+		if (avail < 4)
+			return false;
+		/* A zero count means the real one follows in 64 bits */
+		count_size = 4;
+		if (*(uint32_t *)p == 0 && (w->wire_flags & WIRE_WIDE_COUNTS))
+			count_size = 12;
+		header_size = count_size + (w->wire_version >= 2 ? 8 : 0);
+		if (avail < header_size + 4)
+			return false;
+		if (count_size == 12)
+			e->counter = *(uint64_t *)(p + 4);
+		else
+			e->counter = *(uint32_t *)p;
+		assert(e->counter > 0);
+		len = *(unsigned *)(p + header_size);
+		if (header_size + 4 + len <= avail) {
+			e->len = len;
+			e->word = (unsigned char *)p + header_size + 4;
+			if (w->wire_version >= 2)
+				e->hash = *(uint64_t *)(p + count_size);
+			else
+				e->hash = hash_word(e->word, len);
+			e->key = order_key(e->hash);
+			w->entry_size = header_size + 4 + len;
+			w->entry_in_buffer = true;
+			return true;
+		}
+		if (header_size + 4 + len <= RX_BUFFER_SIZE - MIN_READ_SIZE)
+			return false;
+
+		w->current_word_count = e->counter;
+		if (w->wire_version >= 2)
+			w->current_word_hash = *(uint64_t *)(p + count_size);
+		w->rx_buffer_used += header_size;
 	}
+
 	word = read_string(w);
 	if (!word)
+		return false;
+	e->counter = w->current_word_count;
+	e->len = w->current_word_len;
+	e->word = (unsigned char *)word;
+	if (w->wire_version >= 2)
+		e->hash = w->current_word_hash;
+	else
+		e->hash = hash_word(e->word, e->len);
+	e->key = order_key(e->hash);
+	w->slow_word = word;
+	w->entry_size = 0;
+	w->entry_in_buffer = false;
+	return true;
+}
+
+static void
+consume_entry(struct worker *w)
+{
+	w->rx_buffer_used += w->entry_size;
+	w->entry_size = 0;
+	free(w->slow_word);
+	w->slow_word = NULL;
+}
+
+/* A worker which wasn't started with the right --partitions would
+   send us words which some other reducer is counting. */
+static void
+check_partition(const struct word *e, int wid)
+{
+	int slot = word_slot(e);
+
+	if (slot < partition_lo || slot >= partition_hi)
+		errx(1, "worker %d sent slot %d, which isn't in partition %d/%d",
+		     wid, slot, partition, nr_partitions);
+}
+
+static int
+process_word_entry(struct worker *w, int wid)
+{
+	int idx;
+	struct word e;
+
+	if (!peek_entry(w, &e))
 		return 0;
-	idx = bump_word_counter((unsigned char *)word, strlen(word), w->current_word_count);
+	check_partition(&e, wid);
+	idx = word_table_add(&word_table, e.hash, e.word, e.len, e.counter);
 
 	if (idx < w->finished_hash_entries + 1)
 		DBG("worker %d went backwards through table: %d < %d\n",
@@ -166,42 +533,758 @@ process_word_entry(struct worker *w, int wid)
 	assert(idx >= w->finished_hash_entries + 1);
 	w->finished_hash_entries = idx - 1;
 
-	/* Reset for next word */
-	free(word);
-	w->current_word_count = 0;
+	consume_entry(w);
 
 	return 1;
 }
 
+/* The heap merge engine.  Every worker sends its words in ascending
+   order key, so rather than building a table we keep a heap of each
+   worker's next entry and repeatedly take the smallest.  Entries
+   with the same key are gathered in pending[] and printed once every
+   worker has moved past that key.  Nothing can be decided while any
+   worker which might still produce something has no head entry, so
+   merge_waiting counts those and the merge stops whenever it's
+   non-zero.  The split words from the chunk boundaries go into
+   boundary_words and are merged in as if they were one more
+   worker. */
+static int *merge_heap;
+static int merge_heap_size;
+static int merge_waiting;
+static unsigned boundary_cursor;
+
+/* The words in pending[] are copies, since the heads they came from
+ * get consumed.  Their buffers are reused from one key to the next. */
+struct pending_word {
+	struct word w;
+	unsigned size;
+};
+static struct pending_word *pending;
+static int nr_pending;
+static int pending_size;
+
+static uint64_t
+heap_key(struct worker *workers, int x)
+{
+	return workers[merge_heap[x]].head.key;
+}
+
 static void
-do_rx(struct worker *w, int is_first_worker, int is_last_worker, int id)
+heap_push(struct worker *workers, int wid)
 {
-	ssize_t received;
+	int x, parent, tmp;
 
-	/* Receive as much as possible. */
-	if (w->from_worker_fd > 0) {
-		if (RX_BUFFER_SIZE - w->rx_buffer_avail < MIN_READ_SIZE) {
-			memmove(w->rx_buffer,
-				w->rx_buffer + w->rx_buffer_used,
-				w->rx_buffer_avail - w->rx_buffer_used);
-			w->rx_buffer_avail -= w->rx_buffer_used;
-			w->rx_buffer_used = 0;
-		}
-		received = read(w->from_worker_fd, w->rx_buffer + w->rx_buffer_avail,
-				RX_BUFFER_SIZE - w->rx_buffer_avail);
-		if (received == 0) {
-			close(w->from_worker_fd);
-			w->from_worker_fd = -1;
-			DBG("Finished receiving from worker %d\n", id);
-		} else if (received < 0) {
-			err(1, "receiving from worker");
+	x = merge_heap_size++;
+	merge_heap[x] = wid;
+	while (x > 0) {
+		parent = (x - 1) / 2;
+		if (heap_key(workers, parent) <= heap_key(workers, x))
+			break;
+		tmp = merge_heap[parent];
+		merge_heap[parent] = merge_heap[x];
+		merge_heap[x] = tmp;
+		x = parent;
+	}
+}
+
+static int
+heap_pop(struct worker *workers)
+{
+	int res, x, child, tmp;
+
+	res = merge_heap[0];
+	merge_heap[0] = merge_heap[--merge_heap_size];
+	x = 0;
+	while (1) {
+		child = x * 2 + 1;
+		if (child >= merge_heap_size)
+			break;
+		if (child + 1 < merge_heap_size &&
+		    heap_key(workers, child + 1) < heap_key(workers, child))
+			child++;
+		if (heap_key(workers, x) <= heap_key(workers, child))
+			break;
+		tmp = merge_heap[child];
+		merge_heap[child] = merge_heap[x];
+		merge_heap[x] = tmp;
+		x = child;
+	}
+	return res;
+}
+
+static void
+set_head_state(struct worker *w, int state)
+{
+	if (w->head_state == HEAD_NONE && state != HEAD_NONE)
+		merge_waiting--;
+	else if (w->head_state != HEAD_NONE && state == HEAD_NONE)
+		merge_waiting++;
+	w->head_state = state;
+}
+
+static void
+advance_head(struct worker *workers, int wid)
+{
+	struct worker *w = &workers[wid];
+	bool found;
+
+	while (!(found = peek_entry(w, &w->head)) && inflate_rx(w))
+		;
+	if (found) {
+		check_partition(&w->head, wid);
+		set_head_state(w, HEAD_READY);
+		heap_push(workers, wid);
+	} else if (w->from_worker_fd == -1) {
+		set_head_state(w, HEAD_EOF);
+	} else {
+		set_head_state(w, HEAD_NONE);
+	}
+}
+
+/* Output stage.  Lines are formatted by hand into big private
+   buffers, and a writer thread drains full ones to stdout, so that
+   writing the output overlaps with receiving from the workers.  The
+   buffers are used round robin: output_filled counts the ones handed
+   to the writer, and output_written the ones it's finished with. */
+#define OUTPUT_BUFFER_SIZE (1 << 20)
+#define NR_OUTPUT_BUFFERS 4
+
+static struct {
+	char data[OUTPUT_BUFFER_SIZE];
+	size_t used;
+} *output_buffers;
+static unsigned output_filled;
+static unsigned output_written;
+static bool output_done;
+static pthread_mutex_t output_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t output_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t output_thread;
+
+static void *
+output_writer(void *ignore)
+{
+	const char *p;
+	size_t left;
+	ssize_t s;
+	unsigned b;
+
+	pthread_mutex_lock(&output_lock);
+	while (1) {
+		while (output_written == output_filled && !output_done)
+			pthread_cond_wait(&output_cond, &output_lock);
+		if (output_written == output_filled)
+			break;
+		b = output_written % NR_OUTPUT_BUFFERS;
+		pthread_mutex_unlock(&output_lock);
+
+		p = output_buffers[b].data;
+		left = output_buffers[b].used;
+		while (left) {
+			s = write(1, p, left);
+			if (s < 0 && errno == EINTR)
+				continue;
+			if (s <= 0)
+				err(1, "writing output");
+			p += s;
+			left -= s;
+		}
+		output_buffers[b].used = 0;
+
+		pthread_mutex_lock(&output_lock);
+		output_written++;
+		pthread_cond_signal(&output_cond);
+	}
+	pthread_mutex_unlock(&output_lock);
+	return NULL;
+}
+
+static void
+start_output(void)
+{
+	output_buffers = calloc(NR_OUTPUT_BUFFERS, sizeof(output_buffers[0]));
+	if (!output_buffers)
+		err(1, "allocating output buffers");
+	errno = pthread_create(&output_thread, NULL, output_writer, NULL);
+	if (errno)
+		err(1, "creating output thread");
+}
+
+/* Hand the current buffer to the writer, and wait for the next one
+   to be free. */
+static void
+output_next_buffer(void)
+{
+	pthread_mutex_lock(&output_lock);
+	output_filled++;
+	pthread_cond_signal(&output_cond);
+	while (output_filled - output_written == NR_OUTPUT_BUFFERS)
+		pthread_cond_wait(&output_cond, &output_lock);
+	pthread_mutex_unlock(&output_lock);
+}
+
+static void
+finish_output(void)
+{
+	pthread_mutex_lock(&output_lock);
+	if (output_buffers[output_filled % NR_OUTPUT_BUFFERS].used)
+		output_filled++;
+	output_done = true;
+	pthread_cond_signal(&output_cond);
+	pthread_mutex_unlock(&output_lock);
+	errno = pthread_join(output_thread, NULL);
+	if (errno)
+		err(1, "joining output thread");
+}
+
+static void
+emit_bytes(const void *_p, size_t n)
+{
+	const char *p = _p;
+	size_t this_time;
+	unsigned b;
+
+	while (n) {
+		b = output_filled % NR_OUTPUT_BUFFERS;
+		if (output_buffers[b].used == OUTPUT_BUFFER_SIZE) {
+			output_next_buffer();
+			continue;
+		}
+		this_time = OUTPUT_BUFFER_SIZE - output_buffers[b].used;
+		if (this_time > n)
+			this_time = n;
+		memcpy(output_buffers[b].data + output_buffers[b].used, p,
+		       this_time);
+		output_buffers[b].used += this_time;
+		p += this_time;
+		n -= this_time;
+	}
+}
+
+/* The same as printf("%16llu %.*s\n") */
+static void
+emit_line(uint64_t count, const unsigned char *word, unsigned len)
+{
+	char num[21];
+	char *p;
+
+	p = num + 20;
+	*p = ' ';
+	do {
+		*--p = '0' + count % 10;
+		count /= 10;
+	} while (count);
+	while (p > num + 4)
+		*--p = ' ';
+	emit_bytes(p, num + 21 - p);
+	emit_bytes(word, len);
+	emit_bytes("\n", 1);
+}
+
+/* --top K: rather than printing every word, keep the K most frequent
+   in a min-heap on count, and print just those, most frequent first,
+   at the end.  The heap has its own copies of the words, so nothing
+   else has to be kept around for it. */
+static unsigned top_k;
+static struct word *top_words;
+static unsigned nr_top_words;
+
+/* Does a rank below b?  Ties go to the lexically smaller word, so
+   the output doesn't depend on the order words turn up in. */
+static bool
+top_below(const struct word *a, const struct word *b)
+{
+	int r;
+
+	if (a->counter != b->counter)
+		return a->counter < b->counter;
+	r = memcmp(a->word, b->word, a->len < b->len ? a->len : b->len);
+	if (r)
+		return r > 0;
+	return a->len > b->len;
+}
+
+static void
+top_sift_down(unsigned x)
+{
+	struct word t;
+	unsigned c;
+
+	while ((c = 2 * x + 1) < nr_top_words) {
+		if (c + 1 < nr_top_words &&
+		    top_below(&top_words[c + 1], &top_words[c]))
+			c++;
+		if (!top_below(&top_words[c], &top_words[x]))
+			break;
+		t = top_words[x];
+		top_words[x] = top_words[c];
+		top_words[c] = t;
+		x = c;
+	}
+}
+
+static void
+top_sift_up(unsigned x)
+{
+	struct word t;
+
+	while (x && top_below(&top_words[x], &top_words[(x - 1) / 2])) {
+		t = top_words[x];
+		top_words[x] = top_words[(x - 1) / 2];
+		top_words[(x - 1) / 2] = t;
+		x = (x - 1) / 2;
+	}
+}
+
+static void
+top_offer(const struct word *w)
+{
+	struct word *t;
+
+	if (nr_top_words == top_k) {
+		if (!top_below(&top_words[0], w))
+			return;
+		t = &top_words[0];
+	} else {
+		t = &top_words[nr_top_words++];
+		t->word = NULL;
+	}
+	t->word = realloc(t->word, w->len ? w->len : 1);
+	if (!t->word)
+		err(1, "copying top word");
+	memcpy(t->word, w->word, w->len);
+	t->len = w->len;
+	t->counter = w->counter;
+	if (t == &top_words[0])
+		top_sift_down(0);
+	else
+		top_sift_up(t - top_words);
+}
+
+/* Boundary words can turn up after the same word's already been
+   output, so add them to what's in the heap if they're there. */
+static void
+top_offer_again(const struct word *w)
+{
+	unsigned x;
+
+	for (x = 0; x < nr_top_words; x++) {
+		if (top_words[x].len == w->len &&
+		    !memcmp(top_words[x].word, w->word, w->len)) {
+			top_words[x].counter += w->counter;
+			top_sift_down(x);
+			return;
+		}
+	}
+	top_offer(w);
+}
+
+static int
+top_compare(const void *a, const void *b)
+{
+	if (top_below(a, b))
+		return 1;
+	if (top_below(b, a))
+		return -1;
+	return 0;
+}
+
+static void
+print_top_words(void)
+{
+	unsigned x;
+
+	qsort(top_words, nr_top_words, sizeof(top_words[0]), top_compare);
+	for (x = 0; x < nr_top_words; x++)
+		emit_line(top_words[x].counter, top_words[x].word,
+			  top_words[x].len);
+}
+
+/* --output-file: collect everything, and write it out sorted at the
+   end.  The words themselves are packed into one big buffer. */
+static const char *output_file;
+struct output_word {
+	size_t offset;
+	uint64_t counter;
+	unsigned len;
+};
+static struct output_word *output_words;
+static size_t nr_output_words;
+static size_t output_words_size;
+static unsigned char *output_strings;
+static size_t output_strings_used;
+static size_t output_strings_size;
+
+static void
+collect_word(const struct word *w)
+{
+	struct output_word *o;
+
+	if (nr_output_words == output_words_size) {
+		output_words_size = output_words_size ? output_words_size * 2 : 65536;
+		output_words = realloc(output_words,
+				       output_words_size * sizeof(output_words[0]));
+		if (!output_words)
+			err(1, "growing output word list");
+	}
+	while (output_strings_used + w->len > output_strings_size) {
+		output_strings_size = output_strings_size ? output_strings_size * 2 : (1 << 20);
+		output_strings = realloc(output_strings, output_strings_size);
+		if (!output_strings)
+			err(1, "growing output string buffer");
+	}
+	o = &output_words[nr_output_words++];
+	o->offset = output_strings_used;
+	o->len = w->len;
+	o->counter = w->counter;
+	memcpy(output_strings + output_strings_used, w->word, w->len);
+	output_strings_used += w->len;
+}
+
+static int
+output_word_compare(const void *_a, const void *_b)
+{
+	const struct output_word *a = _a;
+	const struct output_word *b = _b;
+	int r;
+
+	r = memcmp(output_strings + a->offset, output_strings + b->offset,
+		   a->len < b->len ? a->len : b->len);
+	if (r)
+		return r;
+	return (a->len > b->len) - (a->len < b->len);
+}
+
+static void
+write_sorted_output(void)
+{
+	FILE *f;
+	uint64_t *block_offsets;
+	uint64_t offset;
+	uint64_t nr_blocks;
+	uint64_t nr_words;
+	unsigned char buf[SORTED_TRAILER_SIZE];
+	const unsigned char *word;
+	const unsigned char *prev;
+	unsigned prev_len;
+	unsigned shared;
+	unsigned n;
+	uint64_t count;
+	size_t x;
+	size_t y;
+
+	qsort(output_words, nr_output_words, sizeof(output_words[0]),
+	      output_word_compare);
+
+	f = fopen(output_file, "w");
+	if (!f)
+		err(1, "creating %s", output_file);
+	block_offsets = malloc((nr_output_words / SORTED_BLOCK_WORDS + 1) *
+			       sizeof(block_offsets[0]));
+	if (!block_offsets)
+		err(1, "allocating block index");
+
+	put_le64(buf, SORTED_MAGIC);
+	fwrite(buf, 8, 1, f);
+	offset = 8;
+	nr_blocks = 0;
+	nr_words = 0;
+	prev = NULL;
+	prev_len = 0;
+	for (x = 0; x < nr_output_words; x = y) {
+		/* Boundary words can be in the list twice */
+		word = output_strings + output_words[x].offset;
+		count = 0;
+		for (y = x;
+		     y < nr_output_words &&
+			     !output_word_compare(&output_words[x], &output_words[y]);
+		     y++)
+			count += output_words[y].counter;
+
+		shared = 0;
+		if (nr_words % SORTED_BLOCK_WORDS == 0) {
+			block_offsets[nr_blocks++] = offset;
 		} else {
-			w->rx_buffer_avail += received;
+			while (shared < prev_len && shared < output_words[x].len &&
+			       prev[shared] == word[shared])
+				shared++;
 		}
+		n = put_varint(buf, shared);
+		n += put_varint(buf + n, output_words[x].len - shared);
+		fwrite(buf, n, 1, f);
+		fwrite(word + shared, output_words[x].len - shared, 1, f);
+		offset += n + output_words[x].len - shared;
+		n = put_varint(buf, count);
+		fwrite(buf, n, 1, f);
+		offset += n;
+		prev = word;
+		prev_len = output_words[x].len;
+		nr_words++;
+	}
+
+	for (x = 0; x < nr_blocks; x++) {
+		put_le64(buf, block_offsets[x]);
+		fwrite(buf, 8, 1, f);
+	}
+	put_le64(buf, offset);
+	put_le64(buf + 8, nr_blocks);
+	put_le64(buf + 16, nr_words);
+	put_le64(buf + 24, SORTED_BLOCK_WORDS);
+	put_le64(buf + 32, tok_utf8 ? SORTED_UTF8 : 0);
+	put_le64(buf + 40, SORTED_MAGIC);
+	fwrite(buf, SORTED_TRAILER_SIZE, 1, f);
+	if (ferror(f) || fclose(f) == EOF)
+		err(1, "writing %s", output_file);
+	free(block_offsets);
+	DBG("Wrote %lld words to %s\n", (long long)nr_words, output_file);
+}
+
+/* --load-table and --save-table.  The snapshot goes into whichever
+   table collects boundary words, so it's merged with the workers'
+   streams like one more of them, and everything which comes out is
+   written to the new one as it goes. */
+static const char *load_table;
+static const char *save_table;
+static struct snapshot_writer *snapshot;
+
+static void
+output_word(const struct word *w)
+{
+	if (snapshot)
+		snapshot_add(snapshot, w);
+	if (top_k)
+		top_offer(w);
+	else if (output_file)
+		collect_word(w);
+	else
+		emit_line(w->counter, w->word, w->len);
+}
+
+static void
+flush_pending(void)
+{
+	int x;
+
+	for (x = 0; x < nr_pending; x++)
+		output_word(&pending[x].w);
+	nr_pending = 0;
+}
+
+static void
+merge_pending(const struct word *w)
+{
+	struct pending_word *p;
+	int x;
+
+	if (nr_pending && pending[0].w.key != w->key)
+		flush_pending();
+	for (x = 0; x < nr_pending; x++) {
+		if (pending[x].w.hash == w->hash &&
+		    pending[x].w.len == w->len &&
+		    !memcmp(pending[x].w.word, w->word, w->len)) {
+			pending[x].w.counter += w->counter;
+			return;
+		}
+	}
+	if (nr_pending == pending_size) {
+		pending_size = pending_size ? pending_size * 2 : 8;
+		pending = realloc(pending, pending_size * sizeof(pending[0]));
+		if (!pending)
+			err(1, "growing pending word list");
+		memset(pending + nr_pending, 0,
+		       (pending_size - nr_pending) * sizeof(pending[0]));
+	}
+	p = &pending[nr_pending++];
+	if (p->size < w->len) {
+		p->size = w->len;
+		p->w.word = realloc(p->w.word, p->size);
+		if (!p->w.word)
+			err(1, "allocating pending word");
+	}
+	memcpy(p->w.word, w->word, w->len);
+	p->w.key = w->key;
+	p->w.hash = w->hash;
+	p->w.counter = w->counter;
+	p->w.len = w->len;
+}
+
+static void
+run_merge(struct worker *workers)
+{
+	struct word *b;
+	int wid;
+
+	while (!merge_waiting) {
+		b = NULL;
+		for (; boundary_cursor < boundary_words.nr_cells; boundary_cursor++) {
+			if (boundary_words.cells[boundary_cursor].word) {
+				b = &boundary_words.cells[boundary_cursor];
+				break;
+			}
+		}
+		if (!b && !merge_heap_size) {
+			/* Everything's finished */
+			flush_pending();
+			return;
+		}
+		if (b && (!merge_heap_size || b->key <= heap_key(workers, 0))) {
+			merge_pending(b);
+			boundary_cursor++;
+			continue;
+		}
+		wid = heap_pop(workers);
+		merge_pending(&workers[wid].head);
+		consume_entry(&workers[wid]);
+		advance_head(workers, wid);
+	}
+}
+
+/* Should we be reading from this worker at the moment? */
+static bool
+rx_wanted(const struct worker *w)
+{
+	if (w->rx_throttled && !(w->wire_flags & WIRE_CREDIT))
+		return false;
+	/* Don't listen to workers whose buffers are full of entries
+	   which the heap merge can't use yet.  This is what keeps the
+	   fast ones from getting too far ahead. */
+	if (merge_engine == MERGE_HEAP)
+		return rx_room(w) >= MIN_READ_SIZE;
+	/* A zero-length read would look like EOF */
+	return rx_room(w) != 0;
+}
+
+/* Make room for a read from the worker, and say where it should go.
+   Nothing may move the buffer again until rx_received(). */
+static unsigned char *
+rx_read_target(struct worker *w, unsigned *size)
+{
+	if (w->inflating) {
+		memmove(w->zbuf, w->inflater.next_in, w->inflater.avail_in);
+		w->inflater.next_in = w->zbuf;
+		*size = ZBUF_SIZE - w->inflater.avail_in;
+		return w->zbuf + w->inflater.avail_in;
+	}
+	compact_rx_buffer(w);
+	*size = RX_BUFFER_SIZE - w->rx_buffer_avail;
+	return w->rx_buffer + w->rx_buffer_avail;
+}
+
+static void
+rx_received(struct worker *w, ssize_t received, int id)
+{
+	if (received == 0) {
+		close(w->from_worker_fd);
+		w->from_worker_fd = -1;
+		w->finished_ns = monotonic_ns();
+		DBG("Finished receiving from worker %d\n", id);
+		return;
+	}
+	if (received < 0)
+		err(1, "receiving from worker");
+	if (!w->first_result_ns)
+		w->first_result_ns = monotonic_ns();
+	w->bytes_received += received;
+	if (w->inflating) {
+		w->inflater.avail_in += received;
+		inflate_rx(w);
+	} else {
+		w->rx_buffer_avail += received;
+	}
+}
+
+/* Every worker has to put its words in the same slot order, and
+   boundary words get hashed here, so everybody needs the same hash. */
+static void
+check_stream_hash(int id, unsigned function, uint64_t seed)
+{
+	if (!hash_agreed) {
+		if (function >= NR_HASH_FUNCTIONS)
+			errx(1, "worker %d uses unknown hash function %d",
+			     id, function);
+		hash_function = function;
+		hash_seed = seed;
+		hash_agreed = true;
+	} else if (function != hash_function || seed != hash_seed) {
+		errx(1, "worker %d hashes with %s, seed %llx, but we're using %s, seed %llx",
+		     id, function < NR_HASH_FUNCTIONS ? hash_function_names[function] : "?",
+		     (unsigned long long)seed, hash_function_names[hash_function],
+		     (unsigned long long)hash_seed);
+	}
+}
+
+/* Likewise for how the input was split into words */
+static void
+check_stream_tokenizer(int id, uint32_t flags)
+{
+	if (!tokenizer_agreed) {
+		wire_flags |= flags & WIRE_UTF8;
+		init_tokenizer(flags & WIRE_UTF8);
+		tokenizer_agreed = true;
+	} else if ((flags ^ wire_flags) & WIRE_UTF8) {
+		errx(1, "worker %d %s UTF-8, but we %s", id,
+		     flags & WIRE_UTF8 ? "read its input as" : "didn't read its input as",
+		     wire_flags & WIRE_UTF8 ? "want it to" : "don't");
+	}
+}
+
+/* Deal with whatever has turned up in the worker's buffer */
+static void
+process_rx(struct worker *w, int is_first_worker, int is_last_worker, int id)
+{
+	if (!w->wire_version) {
+		struct wire_header hdr;
+
+		if (w->rx_buffer_used + 4 > w->rx_buffer_avail)
+			return;
+		if (get_le32(w->rx_buffer + w->rx_buffer_used) != WIRE_MAGIC) {
+			w->wire_version = 1;
+			check_stream_hash(id, HASH_LEGACY, 0);
+			check_stream_tokenizer(id, 0);
+		} else {
+			if (w->rx_buffer_used + WIRE_HEADER_V2_SIZE > w->rx_buffer_avail)
+				return;
+			if (w->rx_buffer_used +
+			    wire_header_size(get_le32(w->rx_buffer + w->rx_buffer_used + 4)) >
+			    w->rx_buffer_avail)
+				return;
+			get_wire_header(w->rx_buffer + w->rx_buffer_used, &hdr);
+			if (hdr.version < 2 || hdr.version > wire_version ||
+			    (hdr.flags & ~WIRE_FLAGS_SUPPORTED))
+				errx(1, "worker %d wants wire version %d, flags %x",
+				     id, hdr.version, hdr.flags);
+			w->wire_version = hdr.version;
+			w->wire_flags = hdr.flags;
+			w->rx_buffer_used += wire_header_size(hdr.version);
+			if (hdr.version >= 3)
+				check_stream_hash(id, hdr.hash_function,
+						  hdr.hash_seed);
+			else
+				check_stream_hash(id, HASH_LEGACY, 0);
+			check_stream_tokenizer(id, hdr.flags);
+			if (hdr.flags & WIRE_DEFLATE) {
+				/* Anything we've already read past
+				   the header is compressed */
+				w->zbuf = malloc(ZBUF_SIZE);
+				if (!w->zbuf)
+					err(1, "allocating inflate buffer");
+				if (inflateInit(&w->inflater) != Z_OK)
+					errx(1, "initialising inflate");
+				memcpy(w->zbuf, w->rx_buffer + w->rx_buffer_used,
+				       w->rx_buffer_avail - w->rx_buffer_used);
+				w->inflater.next_in = w->zbuf;
+				w->inflater.avail_in = w->rx_buffer_avail - w->rx_buffer_used;
+				w->rx_buffer_avail = w->rx_buffer_used;
+				w->inflating = true;
+				inflate_rx(w);
+			}
+		}
+		DBG("Worker %d speaks wire version %d, flags %x\n", id,
+		    w->wire_version, w->wire_flags);
 	}
 
 	if (!w->prefix_string) {
-		w->prefix_string = read_string(w);
+		while (!(w->prefix_string = read_string(w)) && inflate_rx(w))
+			;
 		if (!w->prefix_string) {
 			DBG("Worker %d hasn't provided a prefix yet\n",
 			       id);
@@ -218,7 +1301,8 @@ do_rx(struct worker *w, int is_first_worker, int is_last_worker, int id)
 	}
 
 	if (!w->suffix_string) {
-		w->suffix_string = read_string(w);
+		while (!(w->suffix_string = read_string(w)) && inflate_rx(w))
+			;
 		if (!w->suffix_string) {
 			DBG("Worker %d hasn't provided a suffix yet\n", id);
 			return;
@@ -232,110 +1316,663 @@ do_rx(struct worker *w, int is_first_worker, int is_last_worker, int id)
 		}
 	}
 
-	while (process_word_entry(w, id))
-		;
+	if (merge_engine == MERGE_HEAP) {
+		if (w->head_state == HEAD_NONE)
+			advance_head(w - id, id);
+		run_merge(w - id);
+		if (w->from_worker_fd == -1) {
+			/* Whatever is left in the buffer gets merged
+			   without any more help from us. */
+			DBG("finished worker %d\n", id);
+			w->finished = 1;
+		}
+		return;
+	}
+
+	do {
+		while (process_word_entry(w, id))
+			;
+	} while (inflate_rx(w));
 
 	if (w->from_worker_fd == -1) {
 		if (w->rx_buffer_used != w->rx_buffer_avail)
 			warnx("worker %d has %d bytes left over at end",
 			      id, w->rx_buffer_avail - w->rx_buffer_used);
+		if (w->inflating && w->inflater.avail_in)
+			warnx("worker %d has %d compressed bytes left over at end",
+			      id, w->inflater.avail_in);
 		DBG("finished worker %d\n", id);
 		w->finished = 1;
+		/* A worker which never got any input has no entries to
+		   move this along, and mustn't hold up the GC. */
+		w->finished_hash_entries = NR_HASH_TABLE_SLOTS - 1;
 	}
 }
 
-static struct timeval start;
+static void
+do_rx(struct worker *w, int is_first_worker, int is_last_worker, int id)
+{
+	unsigned char *buf;
+	unsigned size;
+
+	/* Receive as much as possible. */
+	if (w->from_worker_fd > 0 && rx_room(w) != 0) {
+		buf = rx_read_target(w, &size);
+		rx_received(w, read(w->from_worker_fd, buf, size), id);
+	}
+	process_rx(w, is_first_worker, is_last_worker, id);
+}
+
+static uint64_t start_ns;
 
 static double
 now(void)
 {
-	struct timeval tv;
-	gettimeofday(&tv, NULL);
-	tv.tv_sec -= start.tv_sec;
-	tv.tv_usec -= start.tv_usec;
-	return tv.tv_sec + tv.tv_usec * 1e-6;
+	return (monotonic_ns() - start_ns) * 1e-9;
 }
 
+/* Time spent expiring finished slots, for --metrics */
+static uint64_t gc_ns;
+static unsigned gc_runs;
+
 static void
-compact_heap(struct worker *worker, int nr_workers, struct pollfd *polls)
+set_throttled(struct worker *w, bool throttled)
 {
-	int x;
-	int earliest_finished_slot;
-	struct mallinfo mi;
-	int throttle_worker_slot;
-	bool some_worker_unready;
+	if (throttled == w->rx_throttled)
+		return;
+	if (throttled)
+		w->throttled_since = monotonic_ns();
+	else
+		w->throttled_ns += monotonic_ns() - w->throttled_since;
+	w->rx_throttled = throttled;
+}
+
+static void
+output_and_free_word(struct word *w)
+{
+	output_word(w);
+	bump_free(w->word, w->len + 1);
+}
+
+static void
+send_credit(struct worker *w, int id, int credit)
+{
+	uint32_t c = credit;
+	ssize_t r;
+
+	w->credit = credit;
+	if (!(wire_flags & WIRE_CREDIT))
+		return;
+	/* The worker can close its end as soon as it's sent the last
+	   of its results, before we've noticed. */
+	r = send(w->from_worker_fd, &c, 4, MSG_NOSIGNAL);
+	if (r < 0 && (errno == EPIPE || errno == ECONNRESET))
+		return;
+	if (r != 4)
+		err(1, "sending credit to worker %d", id);
+}
+
+/* Flow control for the table merge.  Every worker has sent all it has
+   up to the frontier, the last slot which the slowest of them has
+   finished, so everything up to there can be written out and dropped
+   from the table.  Each worker is allowed window slots past the
+   frontier, which bounds how much of the table is live at once.  A
+   worker which does WIRE_CREDIT is told how far that is and holds
+   itself back; for any other, including a file offline, we stop
+   reading. */
+static void
+update_credits(struct worker *workers, unsigned nr_workers)
+{
+	int frontier;
+	int credit;
+	uint64_t gc_start;
+	unsigned x;
+
+	if (merge_engine != MERGE_TABLE)
+		return;
 
-	DBG("Start hash table GC\n");
+	frontier = NR_HASH_TABLE_SLOTS - 1;
+	for (x = 0; x < nr_workers; x++) {
+		if (!workers[x].finished &&
+		    workers[x].finished_hash_entries < frontier)
+			frontier = workers[x].finished_hash_entries;
+	}
+	if (frontier == NR_HASH_TABLE_SLOTS - 1)
+		return;
+
+	/* A worker can't have started on the table until it's sent
+	   its boundary words, so by the time there's a frontier all
+	   the split words are in. */
+	credit = frontier + window;
+	if (credit > NR_HASH_TABLE_SLOTS - 1)
+		credit = NR_HASH_TABLE_SLOTS - 1;
 
-	/* Make sure that every worker has its prefix and suffix
-	 * string before doing anything */
-	some_worker_unready = false;
+	if (frontier - last_gced_hash_slot >= window / 4) {
+		DBG("Discarding slots up to %d\n", frontier);
+		gc_start = monotonic_ns();
+		gc_runs++;
+		word_table_expire(&word_table, frontier, output_and_free_word);
+		/* Everything still to come is in the new window */
+		word_table_focus(&word_table, frontier + 1, credit);
+		last_gced_hash_slot = frontier;
+		gc_ns += monotonic_ns() - gc_start;
+	}
 	for (x = 0; x < nr_workers; x++) {
-		if (!worker[x].prefix_string || !worker[x].suffix_string) {
-			DBG("Worker %d hasn't completed its boundary strings", x);
-			some_worker_unready = true;
+		if (workers[x].finished) {
+			set_throttled(&workers[x], false);
+			continue;
 		}
+		if (credit - workers[x].credit >= window / 4 ||
+		    (credit == NR_HASH_TABLE_SLOTS - 1 && workers[x].credit < credit))
+			send_credit(&workers[x], x, credit);
+		/* The last slot there is means no limit at all.
+		 * Anything else would stop us reading a stream whose
+		 * last entry is in it before we've seen its end. */
+		set_throttled(&workers[x],
+			      workers[x].credit < NR_HASH_TABLE_SLOTS - 1 &&
+			      workers[x].finished_hash_entries >= workers[x].credit - 1);
 	}
+}
 
-	if (some_worker_unready) {
-		/* Okay, we're not ready for hash compaction.
-		   Throttle every worker which has prefix and
-		   suffix. */
-		for (x = 0; x < nr_workers; x++) {
-			if (worker[x].prefix_string && worker[x].suffix_string) {
-				if (polls[x].events & POLLIN)
-					DBG("Throttle %d for pre-compaction\n", x);
-				polls[x].events &= ~POLLIN;
+/* --metrics: one JSON object for the whole run, with a per-worker
+   breakdown so that stragglers stand out.  Everything up to
+   merge_start is receiving; after that is the final merge and
+   output. */
+static const char *metrics_file;
+
+static void
+write_metrics(const struct worker *workers, unsigned nr_workers,
+	      uint64_t merge_start)
+{
+	const struct worker *w;
+	uint64_t end;
+	unsigned x;
+	FILE *f;
+
+	end = monotonic_ns();
+	for (x = 0; x < nr_workers; x++) {
+		metrics.bytes_sent += workers[x].bytes_sent;
+		metrics.bytes_received += workers[x].bytes_received;
+	}
+	f = fopen(metrics_file, "w");
+	if (!f) {
+		warn("creating %s", metrics_file);
+		return;
+	}
+	fprintf(f, "{\"program\": \"driver\", \"pid\": %d, "
+		"\"partition\": %d, \"partitions\": %d, "
+		"\"elapsed_s\": %.6f, \"receive_s\": %.6f, \"merge_s\": %.6f, "
+		"\"gc_runs\": %u, \"gc_s\": %.6f, ",
+		(int)getpid(), partition, nr_partitions,
+		(end - start_ns) * 1e-9,
+		(merge_start - start_ns) * 1e-9, (end - merge_start) * 1e-9,
+		gc_runs, gc_ns * 1e-9);
+	metrics_print(f);
+	fprintf(f, ", \"workers\": [");
+	for (x = 0; x < nr_workers; x++) {
+		w = &workers[x];
+		fprintf(f, "%s{\"id\": %u, \"bytes_sent\": %llu, "
+			"\"bytes_received\": %llu, \"throttled_s\": %.6f, "
+			"\"first_result_s\": %.6f, \"finished_s\": %.6f}",
+			x ? ", " : "", x,
+			(unsigned long long)w->bytes_sent,
+			(unsigned long long)w->bytes_received,
+			(w->throttled_ns + (w->rx_throttled ? end - w->throttled_since : 0)) * 1e-9,
+			w->first_result_ns ? (w->first_result_ns - start_ns) * 1e-9 : 0,
+			w->finished_ns ? (w->finished_ns - start_ns) * 1e-9 : 0);
+	}
+	fprintf(f, "]}\n");
+	if (fclose(f) == EOF)
+		warn("writing %s", metrics_file);
+}
+
+/* Take the chunk boundaries from an index written by chunk --index,
+   rather than cutting the input wherever it happens to divide. */
+static void
+load_chunk_index(const char *path, struct worker *workers,
+		 unsigned nr_workers, off_t size)
+{
+	FILE *f;
+	long long start;
+	long long end;
+	long long last_end;
+	unsigned x;
+
+	f = fopen(path, "r");
+	if (!f)
+		err(1, "opening %s", path);
+	last_end = 0;
+	for (x = 0; x < nr_workers; x++) {
+		if (fscanf(f, "%lld %lld", &start, &end) != 2)
+			errx(1, "%s has fewer than %d chunks", path, nr_workers);
+		if (start != last_end || end < start || end > size)
+			errx(1, "%s: bad chunk %lld-%lld", path, start, end);
+		workers[x].send_offset = start;
+		workers[x].end_of_chunk = end;
+		last_end = end;
+	}
+	if (fscanf(f, "%lld", &start) == 1)
+		errx(1, "%s has more than %d chunks", path, nr_workers);
+	if (last_end != size)
+		errx(1, "%s doesn't cover all of the input", path);
+	fclose(f);
+}
+
+/* Work-queue mode.  Workers ask for blocks by writing a byte to their
+   input socket, and each request gets a length and then a block cut
+   on word boundaries, or a zero length once the input's used up.
+   Returns true once the worker has shut its end of the socket, which
+   it does when it's had an answer to every request. */
+static bool
+block_in_progress(const struct worker *w)
+{
+	return w->block_header_sent != sizeof(w->block_header) ||
+		w->send_offset != w->end_of_chunk;
+}
+
+static bool
+serve_blocks(struct worker *w, short revents, int fd, off_t size, int id)
+{
+	char requests[64];
+	ssize_t s;
+	off_t end;
+
+	if (revents & POLLIN) {
+		s = read(w->to_worker_fd, requests, sizeof(requests));
+		if (s == 0) {
+			if (w->block_requests || block_in_progress(w))
+				errx(1, "worker %d went away with blocks outstanding",
+				     id);
+			DBG("Worker %d has all the blocks it wants\n", id);
+			return true;
+		}
+		if (s < 0)
+			err(1, "reading block requests from worker %d", id);
+		w->block_requests += s;
+	}
+
+	while (1) {
+		if (!block_in_progress(w)) {
+			if (!w->block_requests)
+				break;
+			w->block_requests--;
+			end = next_block;
+			if (end < size) {
+				end = next_block + block_size;
+				if (end > size)
+					end = size;
+				end = next_word_boundary(fd, end, size);
+				if (end - next_block > UINT32_MAX)
+					errx(1, "the word at offset %lld takes its block past 4GB",
+					     (long long)(next_block + block_size));
 			}
+			w->send_offset = next_block;
+			w->end_of_chunk = end;
+			w->block_header = end - next_block;
+			w->block_header_sent = 0;
+			next_block = end;
 		}
-		return;
+		if (w->block_header_sent != sizeof(w->block_header)) {
+			s = write(w->to_worker_fd,
+				  (char *)&w->block_header + w->block_header_sent,
+				  sizeof(w->block_header) - w->block_header_sent);
+			if (s < 0 && errno == EAGAIN)
+				break;
+			if (s < 0)
+				err(1, "sending block to worker %d", id);
+			w->bytes_sent += s;
+			w->block_header_sent += s;
+			continue;
+		}
+		s = sendfile(w->to_worker_fd, fd, &w->send_offset,
+			     w->end_of_chunk - w->send_offset);
+		if (s < 0 && errno == EAGAIN)
+			break;
+		if (s <= 0)
+			err(1, "sending block to worker %d", id);
+		w->bytes_sent += s;
 	}
+	return false;
+}
+
+/* The io_uring main loop.  This does the same job as the poll() loop
+   in main(), but without a syscall per worker per trip around it.
+   Each worker has at most one read in flight, straight into its
+   rx_buffer, which is registered with the ring if the kernel lets us.
+   Input goes out as a linked pair of splices, file to pipe and pipe to
+   socket, so it never comes up to user space either. */
+#define URING_SPLICE_SIZE (64 << 10)
+
+enum { URING_RX, URING_SPLICE_IN, URING_SPLICE_OUT };
 
-	earliest_finished_slot = NR_HASH_TABLE_SLOTS;
+static struct {
+	int fd;
+	unsigned sq_entries;
+	unsigned sq_local_tail;
+	unsigned *sq_tail;
+	unsigned *sq_mask;
+	unsigned *sq_array;
+	struct io_uring_sqe *sqes;
+	unsigned *cq_head;
+	unsigned *cq_tail;
+	unsigned *cq_mask;
+	struct io_uring_cqe *cqes;
+	unsigned to_submit;
+	bool fixed_buffers;
+} ring;
+
+static bool
+uring_setup(struct worker *workers, unsigned nr_workers)
+{
+	struct io_uring_params p;
+	struct iovec *iov;
+	char *sq;
+	char *cq;
+	size_t sq_size;
+	size_t cq_size;
+	unsigned entries;
+	unsigned x;
+
+	/* Up to three requests in flight per worker */
+	for (entries = 8; entries < 3 * nr_workers; entries *= 2)
+		;
+	memset(&p, 0, sizeof(p));
+	ring.fd = syscall(__NR_io_uring_setup, entries, &p);
+	if (ring.fd < 0) {
+		warn("io_uring_setup; falling back to poll()");
+		return false;
+	}
+
+	sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if ((p.features & IORING_FEAT_SINGLE_MMAP) && cq_size > sq_size)
+		sq_size = cq_size;
+	sq = mmap(NULL, sq_size, PROT_READ | PROT_WRITE,
+		  MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_SQ_RING);
+	if (sq == MAP_FAILED)
+		err(1, "mapping io_uring submission ring");
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		cq = sq;
+	} else {
+		cq = mmap(NULL, cq_size, PROT_READ | PROT_WRITE,
+			  MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_CQ_RING);
+		if (cq == MAP_FAILED)
+			err(1, "mapping io_uring completion ring");
+	}
+	ring.sqes = mmap(NULL, p.sq_entries * sizeof(struct io_uring_sqe),
+			 PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+			 ring.fd, IORING_OFF_SQES);
+	if (ring.sqes == MAP_FAILED)
+		err(1, "mapping io_uring submission entries");
+
+	ring.sq_entries = p.sq_entries;
+	ring.sq_tail = (unsigned *)(sq + p.sq_off.tail);
+	ring.sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+	ring.sq_array = (unsigned *)(sq + p.sq_off.array);
+	ring.sq_local_tail = *ring.sq_tail;
+	ring.cq_head = (unsigned *)(cq + p.cq_off.head);
+	ring.cq_tail = (unsigned *)(cq + p.cq_off.tail);
+	ring.cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+	ring.cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+
+	iov = calloc(nr_workers, sizeof(iov[0]));
+	if (!iov)
+		err(1, "allocating iovecs");
 	for (x = 0; x < nr_workers; x++) {
-		if (worker[x].finished_hash_entries < earliest_finished_slot)
-			earliest_finished_slot = worker[x].finished_hash_entries;
-	}
-	DBG("Discarding slots up to %d\n", earliest_finished_slot);
-	for (x = 0; x <= earliest_finished_slot; x++) {
-		struct word *w, *n;
-		for (w = hash_table[x]; w; w = n) {
-			n = w->next;
-			printf("%16d %.*s\n",
-			       w->counter,
-			       w->len,
-			       w->word);
-			free(w);
-		}
-		hash_table[x] = NULL;
-	}
-	last_gced_hash_slot = earliest_finished_slot;
-	mi = mallinfo();
-	DBG("Done hash table GC; %d bytes still in use in heap\n", mi.uordblks);
-
-	if (mi.uordblks >= THROTTLE_HEAP_SIZE) {
-		throttle_worker_slot = earliest_finished_slot + 10000;
-		DBG("Going to throttle mode; barrier is %d\n", throttle_worker_slot);
+		iov[x].iov_base = workers[x].rx_buffer;
+		iov[x].iov_len = RX_BUFFER_SIZE;
+	}
+	ring.fixed_buffers = syscall(__NR_io_uring_register, ring.fd,
+				     IORING_REGISTER_BUFFERS, iov,
+				     nr_workers) == 0;
+	if (!ring.fixed_buffers)
+		DBG("Can't register rx buffers (%s); using plain reads\n",
+		    strerror(errno));
+	free(iov);
+	return true;
+}
+
+static struct io_uring_sqe *
+uring_sqe(int opcode, int wid, int type)
+{
+	unsigned idx = ring.sq_local_tail & *ring.sq_mask;
+	struct io_uring_sqe *sqe = &ring.sqes[idx];
+
+	assert(ring.to_submit < ring.sq_entries);
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = opcode;
+	sqe->user_data = ((uint64_t)wid << 2) | type;
+	ring.sq_array[idx] = idx;
+	ring.sq_local_tail++;
+	ring.to_submit++;
+	return sqe;
+}
+
+/* Submit everything queued and wait for at least one completion */
+static void
+uring_enter(void)
+{
+	int r;
+
+	__atomic_store_n(ring.sq_tail, ring.sq_local_tail, __ATOMIC_RELEASE);
+	do {
+		r = syscall(__NR_io_uring_enter, ring.fd, ring.to_submit, 1,
+			    IORING_ENTER_GETEVENTS, NULL, 0);
+	} while (r < 0 && errno == EINTR);
+	if (r < 0)
+		err(1, "io_uring_enter");
+	ring.to_submit -= r;
+}
+
+static void
+uring_queue_rx(struct worker *workers, int wid)
+{
+	struct worker *w = &workers[wid];
+	struct io_uring_sqe *sqe;
+	unsigned char *buf;
+	unsigned size;
+
+	buf = rx_read_target(w, &size);
+	if (ring.fixed_buffers && !w->inflating) {
+		sqe = uring_sqe(IORING_OP_READ_FIXED, wid, URING_RX);
+		sqe->buf_index = wid;
+	} else {
+		sqe = uring_sqe(IORING_OP_READ, wid, URING_RX);
+	}
+	sqe->fd = w->from_worker_fd;
+	sqe->off = (uint64_t)-1;
+	sqe->addr = (unsigned long)buf;
+	sqe->len = size;
+	w->rx_in_flight = true;
+}
+
+static void
+uring_queue_splice(struct worker *workers, int wid, int input_fd)
+{
+	struct worker *w = &workers[wid];
+	struct io_uring_sqe *sqe;
+	unsigned len;
+
+	if (w->in_pipe) {
+		/* Last time's didn't all make it to the worker */
+		len = w->in_pipe;
 	} else {
-		throttle_worker_slot = NR_HASH_TABLE_SLOTS;
-		DBG("Throttle disabled\n");
+		len = URING_SPLICE_SIZE;
+		if (len > w->end_of_chunk - w->send_offset)
+			len = w->end_of_chunk - w->send_offset;
+		sqe = uring_sqe(IORING_OP_SPLICE, wid, URING_SPLICE_IN);
+		sqe->splice_fd_in = input_fd;
+		sqe->splice_off_in = w->send_offset;
+		sqe->fd = w->splice_pipe[1];
+		sqe->off = (uint64_t)-1;
+		sqe->len = len;
+		sqe->flags = IOSQE_IO_LINK;
+		w->splices_in_flight++;
 	}
+	sqe = uring_sqe(IORING_OP_SPLICE, wid, URING_SPLICE_OUT);
+	sqe->splice_fd_in = w->splice_pipe[0];
+	sqe->splice_off_in = (uint64_t)-1;
+	sqe->fd = w->to_worker_fd;
+	sqe->off = (uint64_t)-1;
+	sqe->len = len;
+	w->splices_in_flight++;
+}
+
+static bool
+uring_input_sent(const struct worker *w)
+{
+	return w->send_offset == w->end_of_chunk && !w->in_pipe;
+}
 
+/* Worker wid has all of its input.  In prepopulate mode, nobody gets
+   to start sending results until everybody's got theirs. */
+static void
+uring_finish_sending(struct worker *workers, unsigned nr_workers, int wid,
+		     bool prepopulate, unsigned *nr_sending)
+{
+	unsigned x;
+
+	DBG("Finished sending input to worker %d\n", wid);
+	close(workers[wid].splice_pipe[0]);
+	close(workers[wid].splice_pipe[1]);
+	if (!prepopulate) {
+		close(workers[wid].to_worker_fd);
+		workers[wid].to_worker_fd = -1;
+		return;
+	}
+	if (--*nr_sending)
+		return;
+	DBG("Finished prepopulate phase\n");
 	for (x = 0; x < nr_workers; x++) {
-		if (worker[x].finished_hash_entries >= throttle_worker_slot) {
-			if (polls[x].events & POLLIN)
-				DBG("Worker %d throttles at %d\n", x,
-				    worker[x].finished_hash_entries);
-			polls[x].events &= ~POLLIN;
-		} else if (worker[x].to_worker_fd == -1) {
-			if (!(polls[x].events & POLLIN))
-				DBG("worker %d unthrottled at %d\n", x,
-				    worker[x].finished_hash_entries);
-			polls[x].events |= POLLIN;
-		} else {
-			DBG("worker %d isn't ready to receive results yet\n", x);
+		close(workers[x].to_worker_fd);
+		workers[x].to_worker_fd = -1;
+	}
+}
+
+static void
+clear_nonblock(int fd)
+{
+	int flags = fcntl(fd, F_GETFL);
+
+	if (flags < 0 || fcntl(fd, F_SETFL, flags & ~O_NONBLOCK) < 0)
+		err(1, "clearing O_NONBLOCK");
+}
+
+/* Returns false if we couldn't get a ring, in which case nothing has
+   happened yet and the caller should use poll() instead. */
+static bool
+uring_loop(struct worker *workers, unsigned nr_workers, int input_fd,
+	   bool prepopulate)
+{
+	struct io_uring_cqe *cqe;
+	struct worker *w;
+	unsigned workers_left_alive;
+	unsigned nr_sending;
+	unsigned head;
+	unsigned x;
+	int wid;
+	int res;
+
+	if (!uring_setup(workers, nr_workers))
+		return false;
+
+	/* The ring does its own waiting, and would hand EAGAIN back to
+	   us on a non-blocking fd. */
+	nr_sending = 0;
+	for (x = 0; x < nr_workers; x++) {
+		clear_nonblock(workers[x].from_worker_fd);
+		if (workers[x].to_worker_fd == -1)
+			continue;
+		clear_nonblock(workers[x].to_worker_fd);
+		if (pipe(workers[x].splice_pipe) < 0)
+			err(1, "pipe()");
+		nr_sending++;
+	}
+	for (x = 0; x < nr_workers; x++) {
+		if (workers[x].to_worker_fd != -1 && uring_input_sent(&workers[x]))
+			uring_finish_sending(workers, nr_workers, x, prepopulate,
+					     &nr_sending);
+	}
+
+	workers_left_alive = nr_workers;
+	DBG("Start io_uring loop\n");
+	while (workers_left_alive != 0) {
+		for (x = 0; x < nr_workers; x++) {
+			w = &workers[x];
+			if (w->finished)
+				continue;
+			if (w->to_worker_fd != -1) {
+				if (!w->splices_in_flight && !uring_input_sent(w))
+					uring_queue_splice(workers, x, input_fd);
+			} else if (!w->rx_in_flight && w->from_worker_fd > 0 &&
+				   rx_wanted(w)) {
+				uring_queue_rx(workers, x);
+			}
 		}
+
+		uring_enter();
+
+		head = *ring.cq_head;
+		while (head != __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE)) {
+			cqe = &ring.cqes[head & *ring.cq_mask];
+			wid = cqe->user_data >> 2;
+			res = cqe->res;
+			w = &workers[wid];
+			switch (cqe->user_data & 3) {
+			case URING_RX:
+				w->rx_in_flight = false;
+				if (res == -EAGAIN || res == -EINTR)
+					break;
+				if (res < 0)
+					errno = -res;
+				rx_received(w, res, wid);
+				process_rx(w, wid == 0, wid == nr_workers - 1, wid);
+				if (w->finished) {
+					DBG("expunge worker %d\n", wid);
+					workers_left_alive--;
+				}
+				break;
+			case URING_SPLICE_IN:
+				w->splices_in_flight--;
+				if (res == -EAGAIN || res == -EINTR)
+					break;
+				if (res < 0) {
+					errno = -res;
+					err(1, "reading input for worker %d", wid);
+				}
+				if (res == 0)
+					errx(1, "input file shrank under us");
+				w->send_offset += res;
+				w->in_pipe += res;
+				break;
+			case URING_SPLICE_OUT:
+				w->splices_in_flight--;
+				/* Cancelled because the splice into the pipe came up short */
+				if (res == -ECANCELED || res == -EAGAIN || res == -EINTR)
+					break;
+				if (res < 0) {
+					errno = -res;
+					err(1, "sending to worker %d", wid);
+				}
+				if (res == 0)
+					errx(1, "worker hung up on us");
+				w->in_pipe -= res;
+				w->bytes_sent += res;
+				break;
+			}
+			head++;
+			if ((cqe->user_data & 3) != URING_RX &&
+			    !w->splices_in_flight && uring_input_sent(w))
+				uring_finish_sending(workers, nr_workers, wid,
+						     prepopulate, &nr_sending);
+		}
+		__atomic_store_n(ring.cq_head, head, __ATOMIC_RELEASE);
+
+		update_credits(workers, nr_workers);
 	}
+
+	close(ring.fd);
+	return true;
 }
 
 int
@@ -353,36 +1990,189 @@ main(int argc, char *argv[])
 	int *poll_slots_to_workers;
 	int offline;
 	int prepopulate;
+	const char *index_file;
 	int poll_slots_in_use;
-	struct mallinfo mi;
+	struct word *w;
+	uint64_t merge_start_ns;
 
-	init_malloc(false);
-	gettimeofday(&start, NULL);
+	init_malloc(0);
+	start_ns = monotonic_ns();
+	start_output();
 
 	if (argc == 1)
 		errx(1, "arguments are either --offline and a list of files, or a list of ip port1 port2 triples");
 
 	prepopulate = 0;
-	if (!strcmp(argv[1], "--prepopulate")) {
-		prepopulate = 1;
-		argv++;
-		argc--;
+	index_file = NULL;
+	while (argc > 2) {
+		if (!strcmp(argv[1], "--prepopulate")) {
+			prepopulate = 1;
+			argv++;
+			argc--;
+			continue;
+		}
+		if (!strcmp(argv[1], "--utf8")) {
+			wire_flags |= WIRE_UTF8;
+			tokenizer_agreed = true;
+			argv++;
+			argc--;
+			continue;
+		}
+		if (!strcmp(argv[1], "--merge")) {
+			if (!strcmp(argv[2], "table"))
+				merge_engine = MERGE_TABLE;
+			else if (!strcmp(argv[2], "heap"))
+				merge_engine = MERGE_HEAP;
+			else
+				errx(1, "unknown merge engine %s; want table or heap",
+				     argv[2]);
+		} else if (!strcmp(argv[1], "--wire")) {
+			wire_version = atoi(argv[2]);
+			if (wire_version < 1 || wire_version > WIRE_VERSION)
+				errx(1, "can only speak wire versions 1 to %d",
+				     WIRE_VERSION);
+		} else if (!strcmp(argv[1], "--top")) {
+			if (atoi(argv[2]) < 1)
+				errx(1, "--top needs a positive number of words");
+			top_k = atoi(argv[2]);
+			top_words = calloc(top_k, sizeof(top_words[0]));
+			if (!top_words)
+				err(1, "allocating top %d words", top_k);
+		} else if (!strcmp(argv[1], "--output-file")) {
+			output_file = argv[2];
+		} else if (!strcmp(argv[1], "--metrics")) {
+			metrics_file = argv[2];
+		} else if (!strcmp(argv[1], "--block-size")) {
+			/* Blocks go out with a 32-bit length */
+			block_size = (off_t)atoi(argv[2]) << 20;
+			if (block_size <= 0 || block_size > UINT32_MAX)
+				errx(1, "--block-size is a number of megabytes, less than 4096");
+			wire_flags |= WIRE_WORK_QUEUE;
+		} else if (!strcmp(argv[1], "--index")) {
+			index_file = argv[2];
+		} else if (!strcmp(argv[1], "--loop")) {
+			if (!strcmp(argv[2], "poll"))
+				driver_loop = LOOP_POLL;
+			else if (!strcmp(argv[2], "uring"))
+				driver_loop = LOOP_URING;
+			else
+				errx(1, "unknown loop %s; want poll or uring",
+				     argv[2]);
+		} else if (!strcmp(argv[1], "--encoding")) {
+			wire_flags |= parse_wire_encoding(argv[2]);
+		} else if (!strcmp(argv[1], "--compress")) {
+			wire_flags |= parse_wire_compression(argv[2]);
+		} else if (!strcmp(argv[1], "--hash")) {
+			hash_function = parse_hash_function(argv[2]);
+			hash_agreed = true;
+		} else if (!strcmp(argv[1], "--hash-seed")) {
+			hash_seed = strtoull(argv[2], NULL, 0);
+			hash_agreed = true;
+		} else if (!strcmp(argv[1], "--window")) {
+			window = atoi(argv[2]);
+			if (window < 4)
+				errx(1, "--window needs to be at least 4 slots");
+		} else if (!strcmp(argv[1], "--load-table")) {
+			load_table = argv[2];
+		} else if (!strcmp(argv[1], "--save-table")) {
+			save_table = argv[2];
+		} else if (!strcmp(argv[1], "--partition")) {
+			if (sscanf(argv[2], "%d/%d", &partition, &nr_partitions) != 2 ||
+			    nr_partitions < 1 || partition < 0 ||
+			    partition >= nr_partitions)
+				errx(1, "--partition wants r/n, with r from 0 to n-1");
+			partition_lo = partition_start(partition, nr_partitions);
+			partition_hi = partition_start(partition + 1, nr_partitions);
+		} else {
+			break;
+		}
+		argv += 2;
+		argc -= 2;
 	}
 
 	offline = 0;
 	if (!strcmp(argv[1], "--offline"))
 		offline = 1;
 
+	if (top_k && output_file)
+		errx(1, "--top and --output-file don't go together");
+
+	/* Offline, --hash and --utf8 are just checks on what the streams
+	 * used */
+	if (!offline) {
+		if (wire_version < 3) {
+			if (hash_agreed && (hash_function != HASH_LEGACY || hash_seed))
+				errx(1, "only wire version 3 on can pick the hash");
+			hash_function = HASH_LEGACY;
+			hash_seed = 0;
+		}
+		hash_agreed = true;
+		tokenizer_agreed = true;
+	}
+	if (wire_version < 2 && (wire_flags & WIRE_UTF8))
+		errx(1, "--utf8 needs wire version 2 or later");
+	init_tokenizer(wire_flags & WIRE_UTF8);
+
+	if (load_table) {
+		const struct snapshot_header *s = map_snapshot(load_table);
+
+		/* Offline with no --hash or --utf8, the snapshot decides,
+		 * and the streams have to match it */
+		if (!hash_agreed) {
+			hash_function = s->hash_function;
+			hash_seed = s->hash_seed;
+			hash_agreed = true;
+		}
+		if (!tokenizer_agreed && s->utf8) {
+			wire_flags |= WIRE_UTF8;
+			init_tokenizer(true);
+		}
+		tokenizer_agreed = true;
+		word_table_load(merge_engine == MERGE_HEAP ? &boundary_words : &word_table,
+				s, partition_lo, partition_hi);
+	}
+	if (save_table)
+		snapshot = snapshot_create(save_table);
+
+	last_gced_hash_slot = partition_lo - 1;
+	if (!offline && merge_engine == MERGE_TABLE && wire_version >= 2)
+		wire_flags |= WIRE_CREDIT;
+	if (merge_engine == MERGE_TABLE)
+		word_table_focus(&word_table, partition_lo,
+				 partition_lo + window - 1 < NR_HASH_TABLE_SLOTS - 1 ?
+				 partition_lo + window - 1 : NR_HASH_TABLE_SLOTS - 1);
+
+	if (nr_partitions > 1 && (prepopulate || block_size))
+		errx(1, "--partition can't go with --prepopulate or --block-size");
+
+	if (block_size) {
+		if (offline || prepopulate || index_file)
+			errx(1, "--block-size can't go with --offline, --prepopulate or --index");
+		if (wire_version < 2)
+			errx(1, "--block-size needs wire version 2");
+		if (driver_loop == LOOP_URING) {
+			warnx("--block-size only works with the poll loop");
+			driver_loop = LOOP_POLL;
+		}
+	}
+
 	if (!offline) {
 		if ((argc - 2) % 3)
 			errx(1, "non-integer number of workers?");
 
-		fd = open(argv[1], O_RDONLY);
-		if (fd < 0)
-			err(1, "open(%s)", argv[1]);
-		if (fstat(fd, &statbuf) < 0)
-			err(1, "stat(%s)", argv[1]);
-		size = statbuf.st_size;
+		/* The other reducers take the same arguments as
+		   reducer 0, but leave the input alone. */
+		if (partition == 0) {
+			fd = open(argv[1], O_RDONLY);
+			if (fd < 0)
+				err(1, "open(%s)", argv[1]);
+			if (fstat(fd, &statbuf) < 0)
+				err(1, "stat(%s)", argv[1]);
+			size = statbuf.st_size;
+		} else {
+			fd = -1;
+			size = 0;
+		}
 		nr_workers = (argc - 2) / 3;
 	} else {
 		fd = -1;
@@ -408,21 +2198,50 @@ main(int argc, char *argv[])
 					  &workers[x].to_worker_fd,
 					  &workers[x].from_worker_fd);
 
-			polls[x].fd = workers[x].to_worker_fd;
-			polls[x].events = POLLOUT;
+			if (workers[x].to_worker_fd == -1) {
+				polls[x].fd = workers[x].from_worker_fd;
+				polls[x].events = POLLIN;
+			} else {
+				polls[x].fd = workers[x].to_worker_fd;
+				polls[x].events = block_size ? POLLIN : POLLOUT;
+			}
 
 			workers[x].send_offset = x * (size / nr_workers);
 			if (x != 0)
 				workers[x-1].end_of_chunk = workers[x].send_offset;
 		}
-		workers[x].finished_hash_entries = -1;
+		workers[x].finished_hash_entries = partition_lo - 1;
+		workers[x].credit = merge_engine == MERGE_TABLE ?
+			partition_lo + window - 1 : NR_HASH_TABLE_SLOTS - 1;
 		poll_slots_to_workers[x] = x;
 	}
 	workers[nr_workers - 1].end_of_chunk = size;
+	if (block_size) {
+		for (x = 0; x < nr_workers; x++) {
+			workers[x].send_offset = 0;
+			workers[x].end_of_chunk = 0;
+			workers[x].block_header_sent = sizeof(workers[x].block_header);
+		}
+	}
+	if (index_file) {
+		if (offline)
+			errx(1, "--index only makes sense when sending input to workers");
+		if (partition == 0)
+			load_chunk_index(index_file, workers, nr_workers, size);
+	}
+
+	if (merge_engine == MERGE_HEAP) {
+		merge_heap = calloc(nr_workers, sizeof(merge_heap[0]));
+		merge_waiting = nr_workers;
+	}
 
 	workers_left_alive = nr_workers;
 	poll_slots_in_use = nr_workers;
-	DBG("Start main loop\n");
+	if (driver_loop == LOOP_URING &&
+	    uring_loop(workers, nr_workers, fd, prepopulate))
+		workers_left_alive = 0;
+	else
+		DBG("Start main loop\n");
 	while (workers_left_alive != 0) {
 		int r = poll(polls, poll_slots_in_use, -1);
 		if (r < 0)
@@ -434,8 +2253,29 @@ main(int argc, char *argv[])
 			idx = poll_slots_to_workers[x];
 
 			assert(!(polls[x].revents & POLLNVAL));
-			if (polls[x].revents & POLLERR)
+			if (polls[x].revents & POLLERR) {
+				if (!workers[idx].wire_version && wire_version >= 2)
+					errx(1, "error on worker %d; one from before wire version 2 needs --wire 1",
+					     idx);
 				errx(1, "error on worker %d", idx);
+			}
+			if (block_size && workers[idx].to_worker_fd != -1) {
+				if (polls[x].revents & POLLHUP)
+					errx(1, "worker %d hung up on us when it really shouldn't have done", idx);
+				if (serve_blocks(&workers[idx], polls[x].revents,
+						 fd, size, idx)) {
+					close(workers[idx].to_worker_fd);
+					workers[idx].to_worker_fd = -1;
+					polls[x].fd = workers[idx].from_worker_fd;
+					polls[x].events = POLLIN;
+				} else if (workers[idx].block_requests ||
+					   block_in_progress(&workers[idx])) {
+					polls[x].events = POLLIN | POLLOUT;
+				} else {
+					polls[x].events = POLLIN;
+				}
+				continue;
+			}
 			if (polls[x].revents & POLLHUP) {
 				if (workers[idx].to_worker_fd < 0) {
 					polls[x].revents = POLLIN;
@@ -457,6 +2297,7 @@ main(int argc, char *argv[])
 					errx(1, "worker hung up on us");
 				if (s < 0)
 					err(1, "sending to worker");
+				workers[idx].bytes_sent += s;
 				assert(workers[idx].send_offset <= workers[idx].end_of_chunk);
 				if (workers[idx].send_offset == workers[idx].end_of_chunk) {
 					DBG("Finished sending input to worker %d\n",
@@ -520,34 +2361,54 @@ main(int argc, char *argv[])
 			}
 		}
 
-		mi = mallinfo();
-		if (mi.uordblks > TARGET_MAX_HEAP_SIZE)
-			compact_heap(workers, nr_workers, polls);
+		update_credits(workers, nr_workers);
+
+		for (x = 0; x < poll_slots_in_use; x++) {
+			idx = poll_slots_to_workers[x];
+			if (workers[idx].to_worker_fd != -1)
+				continue;
+			if (rx_wanted(&workers[idx]))
+				polls[x].events |= POLLIN;
+			else
+				polls[x].events &= ~POLLIN;
+		}
 
 	}
 
 	DBG("All done\n");
+	merge_start_ns = monotonic_ns();
 
-	for (idx = last_gced_hash_slot + 1; idx < NR_HASH_TABLE_SLOTS; idx++) {
-		struct word *w;
-		for (w = hash_table[idx]; w; w = w->next) {
-			printf("%16d %.*s\n",
-			       w->counter,
-			       w->len,
-			       w->word);
-		}
+	if (merge_engine == MERGE_HEAP)
+		run_merge(workers);
+
+	for_each_word(&word_table, w) {
+		if (word_slot(w) <= last_gced_hash_slot)
+			continue;
+		output_word(w);
 	}
-	printf("Boundary screw ups:\n");
-	for (idx = 0; idx <= last_gced_hash_slot; idx++) {
-		struct word *w;
-		for (w = hash_table[idx]; w; w = w->next) {
-			printf("%16d %.*s\n",
-			       w->counter,
-			       w->len,
-			       w->word);
+	if (!top_k && !output_file)
+		emit_bytes("Boundary screw ups:\n", 20);
+	for_each_word(&word_table, w) {
+		if (word_slot(w) > last_gced_hash_slot)
+			break;
+		if (top_k) {
+			top_offer_again(w);
+			if (snapshot)
+				snapshot_add(snapshot, w);
+		} else {
+			output_word(w);
 		}
 	}
+	if (snapshot)
+		snapshot_finish(snapshot);
+	if (top_k)
+		print_top_words();
+	if (output_file)
+		write_sorted_output();
+	finish_output();
 	DBG("Finished producing output\n");
+	if (metrics_file)
+		write_metrics(workers, nr_workers, merge_start_ns);
 
 	return 0;
 }
@@ -1,40 +1,30 @@
 /* Worker process */
+#define _GNU_SOURCE
 #include <sys/types.h>
 #include <sys/fcntl.h>
 #include <sys/poll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <arpa/inet.h>
 #include <assert.h>
 #include <err.h>
 #include <errno.h>
+#include <pthread.h>
 #include <setjmp.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <zlib.h>
 
 #include "dwc.h"
 
-static int
-is_space(unsigned char c)
-{
-	return !((c >= '0' && c <= '9') ||
-		 (c >= 'A' && c <= 'Z') ||
-		 (c >= 'a' && c <= 'z'));
-}
-
-static void
-down_case(unsigned char *start, unsigned len)
-{
-	unsigned x;
-	for (x = 0; x < len; x++)
-		if (start[x] >= 'A' && start[x] <= 'Z')
-			start[x] = start[x] - 'A' + 'a';
-}
-
 /* Have a 1MB buffer */
 #define RX_BUFFER_SIZE (1 << 20)
 static int rx_fd;
-static unsigned char rx_buffer[RX_BUFFER_SIZE + 1];
+static unsigned char rx_buffer[RX_BUFFER_SIZE + TOKENIZE_PAD];
+/* Lower-cased copy of the word currently being counted */
+static unsigned char word_buffer[TOKENIZE_OUT_SIZE(RX_BUFFER_SIZE)];
 static unsigned rx_buffer_avail;
 static unsigned rx_buffer_used;
 
@@ -65,14 +55,17 @@ replenish_rx_buffer()
 		err(1, "reading input");
 	if (!rx)
 		longjmp(finished_buffer, 1);
+	metrics.bytes_received += rx;
 	rx_buffer_avail += rx;
 }
 
+/* Everything to do with the stream going out is per-thread, so that
+ * --partitions can send all of its streams at once. */
 #define TX_BUFFER_SIZE (1 << 20)
-static int tx_fd;
-static unsigned char tx_buffer[TX_BUFFER_SIZE];
-static unsigned tx_buffer_producer;
-static unsigned tx_buffer_consumer;
+static __thread int tx_fd;
+static __thread unsigned char *tx_buffer;
+static __thread unsigned tx_buffer_producer;
+static __thread unsigned tx_buffer_consumer;
 
 static void
 flush_some_output()
@@ -99,11 +92,12 @@ retry:
 	}
 	if (sent == 0)
 		errx(1, "receiver hung up on us");
+	metrics.bytes_sent += sent;
 	tx_buffer_consumer += sent;
 }
 
 static void
-transfer_bytes(const void *_bytes, unsigned nr_bytes)
+queue_bytes(const void *_bytes, unsigned nr_bytes)
 {
 	const unsigned char *bytes = _bytes;
 	unsigned transferred;
@@ -127,63 +121,1270 @@ transfer_bytes(const void *_bytes, unsigned nr_bytes)
 	}
 }
 
+/* With WIRE_DEFLATE, output is gathered in deflate_buffer and then
+ * compressed straight into tx_buffer. */
+#define DEFLATE_BUFFER_SIZE (64 << 10)
+static __thread bool compressing;
+static __thread z_stream deflater;
+static __thread unsigned char *deflate_buffer;
+static __thread unsigned deflate_buffer_used;
+
+static void
+deflate_output(int flush)
+{
+	unsigned space;
+	int r;
+
+	deflater.next_in = deflate_buffer;
+	deflater.avail_in = deflate_buffer_used;
+	do {
+		if ( tx_buffer_producer - tx_buffer_consumer == TX_BUFFER_SIZE )
+			flush_some_output();
+		space = TX_BUFFER_SIZE - (tx_buffer_producer - tx_buffer_consumer);
+		if ( space > TX_BUFFER_SIZE - (tx_buffer_producer % TX_BUFFER_SIZE) )
+			space = TX_BUFFER_SIZE - (tx_buffer_producer % TX_BUFFER_SIZE);
+		deflater.next_out = tx_buffer + (tx_buffer_producer % TX_BUFFER_SIZE);
+		deflater.avail_out = space;
+		r = deflate(&deflater, flush);
+		if (r == Z_STREAM_ERROR)
+			errx(1, "deflate failed");
+		tx_buffer_producer += space - deflater.avail_out;
+	} while (deflater.avail_in || !deflater.avail_out ||
+		 (flush == Z_FINISH && r != Z_STREAM_END));
+	deflate_buffer_used = 0;
+}
+
+static void
+transfer_bytes(const void *_bytes, unsigned nr_bytes)
+{
+	const unsigned char *bytes = _bytes;
+	unsigned this_time;
+
+	if (!compressing) {
+		queue_bytes(bytes, nr_bytes);
+		return;
+	}
+	while (nr_bytes) {
+		this_time = DEFLATE_BUFFER_SIZE - deflate_buffer_used;
+		if (this_time > nr_bytes)
+			this_time = nr_bytes;
+		memcpy(deflate_buffer + deflate_buffer_used, bytes, this_time);
+		deflate_buffer_used += this_time;
+		bytes += this_time;
+		nr_bytes -= this_time;
+		if (deflate_buffer_used == DEFLATE_BUFFER_SIZE)
+			deflate_output(Z_NO_FLUSH);
+	}
+}
+
+static int wire_version = WIRE_VERSION;
+/* In --stdin mode, whatever --encoding and --compress said, plus
+ * wide counts.  Otherwise, what the driver asked for. */
+static uint32_t wire_flags = WIRE_WIDE_COUNTS;
+/* The results go to a driver which may have sent a hello we didn't
+ * read */
+static bool unread_hello;
+
+static void
+send_varint(uint64_t v)
+{
+	unsigned char buf[10];
+
+	transfer_bytes(buf, put_varint(buf, v));
+}
+
 static void
 send_word(const unsigned char *start, unsigned size)
 {
-	transfer_bytes(&size, 4);
+	if (wire_flags & WIRE_COMPACT)
+		send_varint(size);
+	else
+		transfer_bytes(&size, 4);
 	transfer_bytes(start, size);
 }
 
+/* WIRE_CREDIT: the last slot the driver has said we can send, the
+ * slot of the last entry we did send, and any part of a credit
+ * message which has turned up so far. */
+static __thread int credit;
+static __thread int sent_slot;
+static __thread unsigned char credit_buf[64];
+static __thread unsigned credit_bytes;
+
+/* Take whatever credit the driver has sent.  False if there wasn't
+   any to take. */
+static bool
+receive_credit(void)
+{
+	uint32_t c;
+	ssize_t r;
+	unsigned x;
+
+	r = read(tx_fd, credit_buf + credit_bytes,
+		 sizeof(credit_buf) - credit_bytes);
+	if (r < 0) {
+		if (errno == EAGAIN)
+			return false;
+		err(1, "receiving credit from driver");
+	}
+	if (r == 0)
+		errx(1, "driver hung up while we still had results for it");
+	metrics.bytes_received += r;
+	credit_bytes += r;
+	for (x = 0; x + 4 <= credit_bytes; x += 4) {
+		memcpy(&c, credit_buf + x, 4);
+		if ((int)c > credit)
+			credit = c;
+	}
+	memmove(credit_buf, credit_buf + x, credit_bytes - x);
+	credit_bytes -= x;
+	return true;
+}
+
+/* Get everything queued so far to the driver, without ending the
+   stream */
+static void
+sync_output(void)
+{
+	if (compressing)
+		deflate_output(Z_SYNC_FLUSH);
+	while (tx_buffer_consumer != tx_buffer_producer)
+		flush_some_output();
+}
+
+/* The driver can only give us more credit once it's seen what we've
+   sent so far, so that has to go before we wait. */
+static void
+wait_for_credit(int slot)
+{
+	struct pollfd p;
+
+	while (slot > credit) {
+		if (receive_credit())
+			continue;
+		sync_output();
+		p.fd = tx_fd;
+		p.events = POLLIN;
+		p.revents = 0;
+		if (poll(&p, 1, -1) < 0)
+			err(1, "waiting for credit");
+	}
+}
+
+/* Closing a socket with credit still unread in it would reset the
+   connection, and could throw away the end of the results before the
+   driver gets them.  So say we're done, and then soak up credit until
+   the driver hangs up.  A newer driver's hello is the same, when
+   we're --wire 1 and never read it. */
+static void
+finish_results(void)
+{
+	struct pollfd p;
+	unsigned char buf[64];
+	ssize_t r;
+
+	if (shutdown(tx_fd, SHUT_WR) < 0)
+		err(1, "shutting down results socket");
+	while ((r = read(tx_fd, buf, sizeof(buf))) != 0) {
+		if (r > 0)
+			continue;
+		if (errno != EAGAIN)
+			err(1, "waiting for the driver to finish");
+		p.fd = tx_fd;
+		p.events = POLLIN;
+		p.revents = 0;
+		if (poll(&p, 1, -1) < 0)
+			err(1, "waiting for the driver to finish");
+	}
+}
+
 static void
 send_words(const struct word *w)
 {
-	transfer_bytes(&w->counter, 4);
+	uint64_t hash;
+	uint32_t count;
+
+	/* One entry past our credit is how the driver knows we've got
+	   there, but a second has to wait. */
+	if (sent_slot > credit)
+		wait_for_credit(sent_slot);
+	sent_slot = word_slot(w);
+
+	if (!(wire_flags & WIRE_COMPACT)) {
+		if (w->counter <= UINT32_MAX) {
+			count = w->counter;
+			transfer_bytes(&count, 4);
+		} else if (wire_flags & WIRE_WIDE_COUNTS) {
+			count = 0;
+			transfer_bytes(&count, 4);
+			transfer_bytes(&w->counter, 8);
+		} else {
+			errx(1, "count %llu won't fit in the wire format",
+			     (unsigned long long)w->counter);
+		}
+		if (wire_version >= 2) {
+			hash = w->hash;
+			transfer_bytes(&hash, 8);
+		}
+		send_word(w->word, w->len);
+		return;
+	}
+
+	send_varint(w->counter);
 	send_word(w->word, w->len);
 }
 
+/* Wait for the driver to tell us which wire version it wants.  With
+   --partitions every reducer says, and we go with what suits all of
+   them. */
+static void
+negotiate_wire_version(int fd, bool first)
+{
+	unsigned char buf[WIRE_HEADER_V3_SIZE];
+	struct wire_header hello;
+	size_t received;
+	size_t size;
+	ssize_t this_time;
+
+	/* The version says how much more of the header there is */
+	size = WIRE_HEADER_V2_SIZE;
+	for (received = 0; received < size; received += this_time) {
+		this_time = read(fd, buf + received, size - received);
+		if (this_time < 0)
+			err(1, "receiving wire version from driver");
+		if (this_time == 0)
+			errx(1, "driver hung up before sending wire version");
+		if (received + this_time == WIRE_HEADER_V2_SIZE)
+			size = wire_header_size(get_le32(buf + 4));
+	}
+	get_wire_header(buf, &hello);
+	if (hello.magic != WIRE_MAGIC)
+		errx(1, "bad wire magic %x from driver", hello.magic);
+	if (hello.version < wire_version)
+		wire_version = hello.version;
+	if (!first && ((hello.flags ^ wire_flags) & WIRE_UTF8))
+		errx(1, "reducers want different tokenizers");
+	if (first)
+		wire_flags = hello.flags & WIRE_FLAGS_SUPPORTED;
+	else
+		wire_flags &= hello.flags;
+	if (wire_version >= 3) {
+		if (hello.hash_function >= NR_HASH_FUNCTIONS)
+			errx(1, "driver wants unknown hash function %d",
+			     hello.hash_function);
+		if (!first && (hello.hash_function != hash_function ||
+			       hello.hash_seed != hash_seed))
+			errx(1, "reducers want different hashes");
+		hash_function = hello.hash_function;
+		hash_seed = hello.hash_seed;
+	}
+}
+
+static void
+send_wire_header(void)
+{
+	unsigned char buf[WIRE_HEADER_V3_SIZE];
+	struct wire_header hdr;
+
+	if (wire_version < 2)
+		return;
+	hdr.magic = WIRE_MAGIC;
+	hdr.version = wire_version;
+	hdr.flags = wire_flags;
+	hdr.hash_function = hash_function;
+	hdr.hash_seed = hash_seed;
+	put_wire_header(buf, &hdr);
+	transfer_bytes(buf, wire_header_size(wire_version));
+
+	if (wire_flags & WIRE_DEFLATE) {
+		if (deflateInit(&deflater,
+				(wire_flags & WIRE_DEFLATE_LEVEL_MASK) >> WIRE_DEFLATE_LEVEL_SHIFT) != Z_OK)
+			errx(1, "initialising deflate");
+		compressing = true;
+	}
+}
+
+/* Start a results stream on fd.  Everything about how it's encoded
+   has to have been settled by now. */
+static void
+open_stream(int fd)
+{
+	tx_fd = fd;
+	set_nonblock(tx_fd);
+	tx_buffer = malloc(TX_BUFFER_SIZE);
+	deflate_buffer = malloc(DEFLATE_BUFFER_SIZE);
+	if (!tx_buffer || !deflate_buffer)
+		err(1, "allocating output buffers");
+	tx_buffer_producer = tx_buffer_consumer = 0;
+	credit = wire_flags & WIRE_CREDIT ? -1 : NR_HASH_TABLE_SLOTS;
+	credit_bytes = 0;
+	sent_slot = -1;
+	send_wire_header();
+}
+
 static void
 flush_output(void)
 {
+	if (compressing) {
+		deflate_output(Z_FINISH);
+		deflateEnd(&deflater);
+		compressing = false;
+	}
 	while (tx_buffer_consumer != tx_buffer_producer)
 		flush_some_output();
 }
 
+/* --min-count: words seen fewer times than this here don't get sent
+   at all.  That throws away words which are rare on every worker but
+   common overall, so it's only for when approximate counts will do,
+   e.g. with driver --top. */
+static int min_count;
+
+/* --metrics: where the end-of-run JSON goes, and when each phase
+   started. */
+static const char *metrics_file;
+static uint64_t start_ns;
+static uint64_t send_start_ns;
+static uint64_t send_end_ns;
+static int counting_threads = 1;
+
+/* --load-table and --save-table.  The snapshot is loaded once the
+   hash is settled, and counting carries on on top of it.  The new
+   one is written just before the table goes out, with everything in
+   it whatever --min-count says. */
+static const char *load_table;
+static const char *save_table;
+static struct snapshot_writer *snapshot;
+
+/* With --stdin or --file, the initial and trailer words are whole
+   words, but they still go out as boundary words for the driver to
+   count, so they never get into the table.  The snapshot needs them,
+   or a run which loads it would come up short, so they're counted
+   in here as well and merged in as it's written.  Fed from a socket,
+   they're only pieces of words, and it's the driver's snapshot which
+   has them whole. */
+static bool local_input;
+static struct word_table edge_words;
+
 static void
-accept_on_ports(int port_nr_1, int port_nr_2,
-		int *fd_1, int *fd_2)
+count_edge_word(const unsigned char *start, unsigned size)
 {
-	int listen_sock_1;
-	int listen_sock_2;
+	unsigned char *buf;
+	unsigned char *word;
+	unsigned pos;
+	unsigned len;
+
+	buf = malloc(size + 1 + TOKENIZE_PAD);
+	word = malloc(TOKENIZE_OUT_SIZE(size));
+	if (!buf || !word)
+		err(1, "allocating %d byte edge word", size);
+	memcpy(buf, start, size);
+	pos = 0;
+	while (1) {
+		buf[size] = 'X';
+		pos = tok_skip_spaces(buf, pos);
+		if (pos >= size)
+			break;
+		buf[size] = ' ';
+		pos = tok_fold_word(buf, pos, word, &len);
+		word_table_bump(&edge_words, word, len, 1);
+	}
+	free(buf);
+	free(word);
+}
+
+/* --partitions: the table goes out as this many streams, one for
+   each contiguous range of slots, each to its own reducer.  Every
+   stream carries the initial and trailer words, which are kept back
+   until the table goes out, and each reducer only counts the
+   boundary words which land in its own range. */
+#define MAX_PARTITIONS 64
+static int nr_partitions = 1;
+static int result_fds[MAX_PARTITIONS];
+static unsigned char *boundary_words[2];
+static unsigned boundary_lens[2];
+static int nr_boundary_words;
+
+static void
+send_boundary_word(const unsigned char *start, unsigned size)
+{
+	if (local_input && save_table)
+		count_edge_word(start, size);
+	if (nr_partitions == 1) {
+		send_word(start, size);
+		return;
+	}
+	assert(nr_boundary_words < 2);
+	boundary_words[nr_boundary_words] = malloc(size + 1);
+	if (!boundary_words[nr_boundary_words])
+		err(1, "allocating boundary word");
+	memcpy(boundary_words[nr_boundary_words], start, size);
+	boundary_lens[nr_boundary_words++] = size;
+}
+
+/* --memory-limit: once the table and the words in it take up more
+   than this, the table goes out to a run file, in the same order as
+   it would go on the wire, and counting carries on with an empty
+   table and arena.  The runs and whatever's left in memory are
+   merged as the results are sent.  Each entry in a run is a 64-bit
+   count, the 64-bit hash, a 32-bit length and then the word. */
+#define RUN_ENTRY_HEADER 20
+#define RUN_BUFFER_SIZE (1 << 20)
+#define RUN_READ_SIZE (64 << 10)
+/* Any less than this and we'd spend all our time spilling */
+#define MIN_SPILL_LIMIT (16ul << 20)
+struct run {
+	int fd;
+	/* Where each partition's words start, and where the last
+	 * one's end */
+	off_t starts[MAX_PARTITIONS + 1];
+};
+static size_t memory_limit;
+/* What each counting table gets of memory_limit */
+static size_t spill_limit;
+static const char *spill_dir;
+static struct run *runs;
+static int nr_runs;
+static uint64_t spilled_bytes;
+static pthread_mutex_t runs_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void
+write_fully(int fd, const void *_buf, size_t size)
+{
+	const unsigned char *buf = _buf;
+	ssize_t r;
+
+	while (size) {
+		r = write(fd, buf, size);
+		if (r < 0)
+			err(1, "writing run file");
+		buf += r;
+		size -= r;
+	}
+}
+
+/* Write t out as a run, and empty it.  t has to be the only table
+   with words from this thread's arenas. */
+static void
+spill(struct word_table *t)
+{
+	struct run run;
+	struct word *w;
+	unsigned char *buf;
+	size_t used;
+	off_t offset;
+	char *path;
+	int r;
+
+	if (asprintf(&path, "%s/dwc-run-XXXXXX", spill_dir) < 0)
+		err(1, "asprintf");
+	run.fd = mkstemp(path);
+	if (run.fd < 0)
+		err(1, "creating run file %s", path);
+	unlink(path);
+	free(path);
+
+	buf = malloc(RUN_BUFFER_SIZE);
+	if (!buf)
+		err(1, "allocating run buffer");
+	used = 0;
+	offset = 0;
+	r = 0;
+	run.starts[0] = 0;
+	for_each_word(t, w) {
+		while (r < nr_partitions &&
+		       word_slot(w) >= partition_start(r + 1, nr_partitions))
+			run.starts[++r] = offset;
+		if (used + RUN_ENTRY_HEADER + w->len > RUN_BUFFER_SIZE) {
+			write_fully(run.fd, buf, used);
+			used = 0;
+		}
+		memcpy(buf + used, &w->counter, 8);
+		memcpy(buf + used + 8, &w->hash, 8);
+		memcpy(buf + used + 16, &w->len, 4);
+		used += RUN_ENTRY_HEADER;
+		if (used + w->len > RUN_BUFFER_SIZE) {
+			write_fully(run.fd, buf, used);
+			write_fully(run.fd, w->word, w->len);
+			used = 0;
+		} else {
+			memcpy(buf + used, w->word, w->len);
+			used += w->len;
+		}
+		offset += RUN_ENTRY_HEADER + w->len;
+		bump_free(w->word, w->len + 1);
+	}
+	while (r < nr_partitions)
+		run.starts[++r] = offset;
+	write_fully(run.fd, buf, used);
+	free(buf);
+
+	free(t->cells);
+	metrics.table_bytes -= t->nr_cells * sizeof(t->cells[0]);
+	memset(t, 0, sizeof(*t));
+	bump_reset();
+
+	pthread_mutex_lock(&runs_lock);
+	runs = realloc(runs, (nr_runs + 1) * sizeof(runs[0]));
+	if (!runs)
+		err(1, "allocating run list");
+	runs[nr_runs++] = run;
+	spilled_bytes += offset;
+	pthread_mutex_unlock(&runs_lock);
+}
+
+static inline void
+check_memory(struct word_table *t)
+{
+	if (spill_limit &&
+	    metrics.arena_bytes + metrics.heap_bytes + metrics.table_bytes > spill_limit)
+		spill(t);
+}
+
+/* Where the merge is up to in one of the runs, or in word_table */
+struct merge_source {
+	bool live;
+	struct word head;
+
+	/* Runs */
+	int fd;
+	off_t offset;
+	off_t end;
+	unsigned char *buf;
+	size_t size;
+	size_t avail;
+	size_t used;
+
+	/* word_table */
+	struct word *pos;
+	struct word *table_end;
+	int hi;
+};
+
+/* Get at least n bytes of the run into the buffer.  False if the
+   partition ends first. */
+static bool
+run_fill(struct merge_source *src, size_t n)
+{
+	size_t want;
+	ssize_t r;
+
+	if (src->avail - src->used >= n)
+		return true;
+	memmove(src->buf, src->buf + src->used, src->avail - src->used);
+	src->avail -= src->used;
+	src->used = 0;
+	if (n > src->size) {
+		src->size = n;
+		src->buf = realloc(src->buf, src->size);
+		if (!src->buf)
+			err(1, "allocating %zd byte run buffer", src->size);
+	}
+	while (src->avail < n) {
+		want = src->size - src->avail;
+		if (want > src->end - src->offset)
+			want = src->end - src->offset;
+		if (!want)
+			return false;
+		r = pread(src->fd, src->buf + src->avail, want, src->offset);
+		if (r < 0)
+			err(1, "reading run file");
+		if (r == 0)
+			errx(1, "run file is short");
+		src->avail += r;
+		src->offset += r;
+	}
+	return true;
+}
+
+/* Move src on to its next word.  Until then, src->head.word stays
+   valid. */
+static void
+source_next(struct merge_source *src)
+{
+	uint32_t len;
+
+	if (src->buf) {
+		src->live = run_fill(src, RUN_ENTRY_HEADER);
+		if (!src->live)
+			return;
+		memcpy(&src->head.counter, src->buf + src->used, 8);
+		memcpy(&src->head.hash, src->buf + src->used + 8, 8);
+		memcpy(&len, src->buf + src->used + 16, 4);
+		if (!run_fill(src, RUN_ENTRY_HEADER + len))
+			errx(1, "run file ends in the middle of a word");
+		src->head.key = order_key(src->head.hash);
+		src->head.word = src->buf + src->used + RUN_ENTRY_HEADER;
+		src->head.len = len;
+		src->used += RUN_ENTRY_HEADER + len;
+		return;
+	}
+	while (src->pos < src->table_end && !src->pos->word)
+		src->pos++;
+	src->live = src->pos < src->table_end && word_slot(src->pos) < src->hi;
+	if (src->live)
+		src->head = *src->pos++;
+}
+
+/* All the copies of one order key, with the same words added up */
+struct group_word {
+	uint64_t hash;
+	uint64_t counter;
+	size_t offset;
+	unsigned len;
+};
+
+static void
+group_add(struct group_word **group, unsigned *nr_group, unsigned *group_size,
+	  unsigned char **strings, size_t *used, size_t *size,
+	  const struct word *w)
+{
+	struct group_word *g;
+	unsigned x;
+
+	for (x = 0; x < *nr_group; x++) {
+		g = &(*group)[x];
+		if (g->hash == w->hash && g->len == w->len &&
+		    !memcmp(*strings + g->offset, w->word, w->len)) {
+			g->counter += w->counter;
+			return;
+		}
+	}
+	if (*nr_group == *group_size) {
+		*group_size = *group_size ? *group_size * 2 : 16;
+		*group = realloc(*group, *group_size * sizeof((*group)[0]));
+		if (!*group)
+			err(1, "allocating merge group");
+	}
+	if (*used + w->len > *size) {
+		while (*used + w->len > *size)
+			*size = *size ? *size * 2 : 4096;
+		*strings = realloc(*strings, *size);
+		if (!*strings)
+			err(1, "allocating merge group strings");
+	}
+	g = &(*group)[(*nr_group)++];
+	g->hash = w->hash;
+	g->counter = w->counter;
+	g->offset = *used;
+	g->len = w->len;
+	memcpy(*strings + *used, w->word, w->len);
+	*used += w->len;
+}
+
+static void
+table_source(struct merge_source *src, struct word_table *t, int r)
+{
+	src->pos = word_table_seek(t, partition_start(r, nr_partitions));
+	src->table_end = t->cells + t->nr_cells;
+	src->hi = partition_start(r + 1, nr_partitions);
+}
+
+/* Pass partition r from the runs, word_table and, if it isn't NULL,
+   extra together to fn */
+static void
+merge_runs(int r, struct word_table *extra, void (*fn)(const struct word *w))
+{
+	struct merge_source *sources;
+	struct group_word *group;
+	unsigned nr_group;
+	unsigned group_size;
+	unsigned char *strings;
+	size_t strings_size;
+	size_t strings_used;
+	struct word w;
+	uint64_t key;
+	bool found;
+	int nr_sources;
+	int x;
+	unsigned y;
+
+	nr_sources = nr_runs + (extra ? 2 : 1);
+	sources = calloc(nr_sources, sizeof(sources[0]));
+	if (!sources)
+		err(1, "allocating merge sources");
+	for (x = 0; x < nr_runs; x++) {
+		sources[x].fd = runs[x].fd;
+		sources[x].offset = runs[x].starts[r];
+		sources[x].end = runs[x].starts[r + 1];
+		sources[x].size = RUN_READ_SIZE;
+		sources[x].buf = malloc(RUN_READ_SIZE);
+		if (!sources[x].buf)
+			err(1, "allocating run buffer");
+	}
+	table_source(&sources[nr_runs], &word_table, r);
+	if (extra)
+		table_source(&sources[nr_runs + 1], extra, r);
+	for (x = 0; x < nr_sources; x++)
+		source_next(&sources[x]);
+
+	group = NULL;
+	group_size = 0;
+	strings = NULL;
+	strings_size = 0;
+	while (1) {
+		found = false;
+		key = 0;
+		for (x = 0; x < nr_sources; x++) {
+			if (sources[x].live && (!found || sources[x].head.key < key)) {
+				key = sources[x].head.key;
+				found = true;
+			}
+		}
+		if (!found)
+			break;
+
+		nr_group = 0;
+		strings_used = 0;
+		for (x = 0; x < nr_sources; x++) {
+			while (sources[x].live && sources[x].head.key == key) {
+				group_add(&group, &nr_group, &group_size,
+					  &strings, &strings_used,
+					  &strings_size, &sources[x].head);
+				source_next(&sources[x]);
+			}
+		}
+		for (y = 0; y < nr_group; y++) {
+			w.key = key;
+			w.hash = group[y].hash;
+			w.counter = group[y].counter;
+			w.word = strings + group[y].offset;
+			w.len = group[y].len;
+			fn(&w);
+		}
+	}
+
+	for (x = 0; x < nr_runs; x++)
+		free(sources[x].buf);
+	free(sources);
+	free(group);
+	free(strings);
+}
+
+static void
+send_counted(const struct word *w)
+{
+	if (w->counter >= min_count)
+		send_words(w);
+}
+
+/* Send partition r's words (all of them, without --partitions), and
+   finish the stream */
+static void
+send_slots(int r)
+{
+	struct word *w;
+	struct word *end;
+	int idx;
+	int hi;
+
+	if (nr_runs) {
+		merge_runs(r, NULL, send_counted);
+		goto out;
+	}
+
+	idx = partition_start(r, nr_partitions);
+	hi = partition_start(r + 1, nr_partitions);
+	end = word_table.cells + word_table.nr_cells;
+	for (w = word_table_seek(&word_table, idx); w < end; w++) {
+		if (!w->word)
+			continue;
+		if (word_slot(w) >= hi)
+			break;
+		assert(word_slot(w) >= idx);
+		idx = word_slot(w);
+		if (w->counter < min_count)
+			continue;
+		send_words(w);
+	}
+
+out:
+	flush_output();
+
+	if ((wire_flags & WIRE_CREDIT) || unread_hello)
+		finish_results();
+	close(tx_fd);
+}
+
+static void *
+send_partition(void *_r)
+{
+	int r = (intptr_t)_r;
+
+	open_stream(result_fds[r]);
+	send_word(boundary_words[0], boundary_lens[0]);
+	send_word(boundary_words[1], boundary_lens[1]);
+	send_slots(r);
+	metrics_flush();
+	return NULL;
+}
+
+static void
+snapshot_word(const struct word *w)
+{
+	snapshot_add(snapshot, w);
+}
+
+static void
+write_snapshot(void)
+{
+	struct word *w;
+	int r;
+
+	snapshot = snapshot_create(save_table);
+	if (nr_runs || edge_words.nr_used) {
+		for (r = 0; r < nr_partitions; r++)
+			merge_runs(r, &edge_words, snapshot_word);
+	} else {
+		for_each_word(&word_table, w)
+			snapshot_add(snapshot, w);
+	}
+	snapshot_finish(snapshot);
+	snapshot = NULL;
+}
+
+static void
+send_table(void)
+{
+	pthread_t threads[MAX_PARTITIONS];
+	int x;
+
+	if (save_table)
+		write_snapshot();
+	send_start_ns = monotonic_ns();
+	if (nr_partitions == 1) {
+		send_slots(0);
+	} else {
+		assert(nr_boundary_words == 2);
+		for (x = 0; x < nr_partitions; x++) {
+			errno = pthread_create(&threads[x], NULL, send_partition,
+					       (void *)(intptr_t)x);
+			if (errno)
+				err(1, "creating thread for partition %d", x);
+		}
+		for (x = 0; x < nr_partitions; x++) {
+			errno = pthread_join(threads[x], NULL);
+			if (errno)
+				err(1, "joining thread for partition %d", x);
+		}
+	}
+	send_end_ns = monotonic_ns();
+}
+
+static void
+write_metrics(void)
+{
+	uint64_t end_ns;
+	FILE *f;
+
+	end_ns = monotonic_ns();
+	if (!send_start_ns)
+		send_start_ns = send_end_ns = end_ns;
+	f = fopen(metrics_file, "w");
+	if (!f) {
+		warn("creating %s", metrics_file);
+		return;
+	}
+	fprintf(f, "{\"program\": \"worker\", \"pid\": %d, \"threads\": %d, "
+		"\"elapsed_s\": %.6f, \"count_s\": %.6f, \"send_s\": %.6f, "
+		"\"runs\": %d, \"spilled_bytes\": %llu, ",
+		(int)getpid(), counting_threads, (end_ns - start_ns) * 1e-9,
+		(send_start_ns - start_ns) * 1e-9,
+		(send_end_ns - send_start_ns) * 1e-9,
+		nr_runs, (unsigned long long)spilled_bytes);
+	metrics_print(f);
+	fprintf(f, "}\n");
+	if (fclose(f) == EOF)
+		warn("writing %s", metrics_file);
+}
+
+/* --threads mode: pull the whole input into memory, cut it into
+   word-aligned ranges, and count each range on its own thread with
+   its own table and arena.  The tables are merged into word_table
+   at the end, so what goes on the wire is the same as for a single
+   thread. */
+struct count_thread {
+	pthread_t thread;
+	const unsigned char *start;
+	size_t size;
+	struct word_table table;
+};
+
+/* Count every word in a range.  The range has to end on a space,
+   and there has to be a non-space somewhere after that, so that
+   neither scan can run away.  word_buf needs room for the longest
+   word plus TOKENIZE_PAD. */
+static void
+count_range(struct word_table *t, const unsigned char *start, size_t size,
+	    unsigned char *word_buf)
+{
+	unsigned pos;
+	unsigned word_end;
+	unsigned len;
+
+	pos = 0;
+	while (1) {
+		/* The tokenizer works in unsigned offsets, so move
+		   start up every so often for ranges over 4GB. */
+		if (pos >= 1u << 30) {
+			start += pos;
+			size -= pos;
+			pos = 0;
+		}
+		pos = tok_skip_spaces(start, pos);
+		if (pos >= size)
+			break;
+		word_end = tok_fold_word(start, pos, word_buf, &len);
+		word_table_bump(t, word_buf, len, 1);
+		check_memory(t);
+		pos = word_end;
+	}
+}
+
+static void *
+count_thread(void *_ct)
+{
+	struct count_thread *ct = _ct;
+	unsigned char *word_buf;
+
+	/* No word in the range can be longer than the range, and
+	   only the pages the longest word touches get faulted in. */
+	word_buf = mmap(NULL, TOKENIZE_OUT_SIZE(ct->size), PROT_READ|PROT_WRITE,
+			MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+	if (word_buf == MAP_FAILED)
+		err(1, "mapping word buffer");
+
+	/* Ranges always end on a space, and the input as a whole
+	   ends with a sentinel. */
+	count_range(&ct->table, ct->start, ct->size, word_buf);
+
+	munmap(word_buf, TOKENIZE_OUT_SIZE(ct->size));
+	metrics_flush();
+	return NULL;
+}
+
+static unsigned char *
+slurp_input(int fd, size_t *size)
+{
+	unsigned char *buf;
+	size_t allocated;
+	size_t used;
+	ssize_t rx;
+
+	buf = NULL;
+	allocated = 0;
+	used = 0;
+	while (1) {
+		if (allocated - used < MIN_READ_SIZE + TOKENIZE_PAD) {
+			allocated = allocated ? allocated * 2 : RX_BUFFER_SIZE;
+			buf = realloc(buf, allocated);
+			if (!buf)
+				err(1, "growing input buffer to %zd bytes",
+				    allocated);
+		}
+		rx = read(fd, buf + used, allocated - used - TOKENIZE_PAD);
+		if (rx < 0)
+			err(1, "reading input");
+		if (rx == 0)
+			break;
+		metrics.bytes_received += rx;
+		used += rx;
+	}
+	*size = used;
+	return buf;
+}
+
+/* --mmap: count straight out of a mapping of the input file.  The
+   file is mapped over the front of an anonymous reservation, so the
+   sentinel and the tokenizer's overrun land in private memory rather
+   than off the end of the file. */
+static unsigned char *
+map_input(int fd, size_t *size, size_t *mapped)
+{
+	struct stat st;
+	unsigned char *buf;
+	size_t page;
+
+	if (fstat(fd, &st) < 0)
+		err(1, "stat input");
+	if (!S_ISREG(st.st_mode))
+		return NULL;
+	page = sysconf(_SC_PAGESIZE);
+	*size = st.st_size;
+	*mapped = (*size + 1 + TOKENIZE_PAD + page - 1) & ~(page - 1);
+	buf = mmap(NULL, *mapped, PROT_READ|PROT_WRITE,
+		   MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+	if (buf == MAP_FAILED)
+		err(1, "reserving %zd bytes for input", *mapped);
+	if (*size && mmap(buf, *size, PROT_READ|PROT_WRITE,
+			  MAP_PRIVATE|MAP_FIXED, fd, 0) == MAP_FAILED)
+		err(1, "mapping input");
+	/* Only hints, so don't care if they fail */
+	metrics.bytes_received += *size;
+	madvise(buf, *size, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+	madvise(buf, *size, MADV_HUGEPAGE);
+#endif
+	return buf;
+}
+
+/* Count everything in buf, which has room for a sentinel and
+   TOKENIZE_PAD after size bytes of input. */
+static void
+count_buffer(unsigned char *buf, size_t size, int nr_threads)
+{
+	size_t prefix_end;
+	size_t trailer_start;
+	size_t cut;
+	size_t begin;
+	struct count_thread *threads;
+	int x;
+
+	buf[size] = 'X';
+
+	for (prefix_end = 0;
+	     prefix_end < size && !is_break(buf[prefix_end]);
+	     prefix_end++)
+		;
+	if (prefix_end == size) {
+		/* No spaces at all.  The single-threaded loop sends
+		   that as an empty initial word and a trailer of
+		   everything, so do the same here. */
+		prefix_end = 0;
+		trailer_start = 0;
+	} else {
+		for (trailer_start = size;
+		     !is_break(buf[trailer_start - 1]);
+		     trailer_start--)
+			;
+	}
+	send_boundary_word(buf, prefix_end);
+	send_boundary_word(buf + trailer_start, size - trailer_start);
+
+	counting_threads = nr_threads;
+	if (memory_limit) {
+		spill_limit = memory_limit / nr_threads;
+		if (spill_limit < MIN_SPILL_LIMIT)
+			spill_limit = MIN_SPILL_LIMIT;
+	}
+	threads = calloc(nr_threads, sizeof(threads[0]));
+	begin = prefix_end;
+	for (x = 0; x < nr_threads; x++) {
+		if (x == nr_threads - 1) {
+			cut = trailer_start;
+		} else {
+			cut = prefix_end + (trailer_start - prefix_end) / nr_threads * (x + 1);
+			if (cut < begin)
+				cut = begin;
+			while (cut < trailer_start && !is_break(buf[cut]))
+				cut++;
+		}
+		threads[x].start = buf + begin;
+		threads[x].size = cut - begin;
+		errno = pthread_create(&threads[x].thread, NULL, count_thread,
+				       &threads[x]);
+		if (errno)
+			err(1, "creating counting thread %d", x);
+		begin = cut;
+	}
+	for (x = 0; x < nr_threads; x++) {
+		errno = pthread_join(threads[x].thread, NULL);
+		if (errno)
+			err(1, "joining counting thread %d", x);
+		word_table_merge(&word_table, &threads[x].table);
+	}
+	free(threads);
+}
+
+static void
+count_with_threads(int nr_threads)
+{
+	unsigned char *buf;
+	size_t size;
+
+	buf = slurp_input(rx_fd, &size);
+	close(rx_fd);
+	count_buffer(buf, size, nr_threads);
+	free(buf);
+}
+
+static bool
+count_mapped(int nr_threads)
+{
+	unsigned char *buf;
+	size_t size;
+	size_t mapped;
+
+	buf = map_input(rx_fd, &size, &mapped);
+	if (!buf)
+		return false;
+	close(rx_fd);
+	count_buffer(buf, size, nr_threads);
+	munmap(buf, mapped);
+	return true;
+}
+
+static void
+read_fully(int fd, void *_buf, size_t size)
+{
+	unsigned char *buf = _buf;
+	ssize_t r;
+
+	while (size) {
+		r = read(fd, buf, size);
+		if (r == 0)
+			errx(1, "driver hung up in the middle of a block");
+		if (r < 0)
+			err(1, "reading block from driver");
+		metrics.bytes_received += r;
+		buf += r;
+		size -= r;
+	}
+}
+
+static void
+request_block(void)
+{
+	if (write(rx_fd, "R", 1) != 1)
+		err(1, "asking driver for a block");
+}
+
+/* Work-queue mode: keep asking the driver for blocks of input and
+   count them all into the one table.  One request is kept in flight
+   ahead of the block being counted, so that the next block is on its
+   way while we work on this one. */
+static void
+count_blocks(void)
+{
+	unsigned char *buf;
+	size_t buf_size;
+	uint32_t len;
+	int outstanding;
+	bool done;
+
+	/* Every block is whole words */
+	send_boundary_word((const unsigned char *)"", 0);
+	send_boundary_word((const unsigned char *)"", 0);
+
+	buf = NULL;
+	buf_size = 0;
+	done = false;
+	request_block();
+	request_block();
+	outstanding = 2;
+	while (outstanding) {
+		read_fully(rx_fd, &len, sizeof(len));
+		outstanding--;
+		if (len == 0) {
+			done = true;
+			continue;
+		}
+		if (done)
+			errx(1, "driver sent a block after saying it had run out");
+		request_block();
+		outstanding++;
+
+		/* The block, then a space to stop the last word and
+		   a non-space to stop the last run of spaces.  The
+		   block is the same size as the longest possible
+		   word, so the word buffer after it has to grow with
+		   it. */
+		if (buf_size < len + 2 + TOKENIZE_PAD) {
+			free(buf);
+			buf_size = len + 2 + TOKENIZE_PAD;
+			buf = malloc(buf_size + TOKENIZE_OUT_SIZE(buf_size));
+			if (!buf)
+				err(1, "allocating %zd byte block buffer",
+				    buf_size + TOKENIZE_OUT_SIZE(buf_size));
+		}
+		read_fully(rx_fd, buf, len);
+		buf[len] = ' ';
+		buf[len + 1] = 'X';
+		count_range(&word_table, buf, len, buf + buf_size);
+	}
+	free(buf);
+	close(rx_fd);
+}
+
+static int
+listen_on_port(int port_nr)
+{
+	int listen_sock;
 	struct sockaddr_in sin;
 
-	listen_sock_1 = socket(AF_INET, SOCK_STREAM, 0);
-	if (listen_sock_1 < 0)
+	listen_sock = socket(AF_INET, SOCK_STREAM, 0);
+	if (listen_sock < 0)
 		err(1, "creating listening socket");
 	memset(&sin, 0, sizeof(sin));
 	sin.sin_family = AF_INET;
-	sin.sin_port = htons(port_nr_1);
-	if (bind(listen_sock_1, (struct sockaddr *)&sin, sizeof(sin)) < 0)
-		err(1, "binding to port %d", port_nr_1);
-	if (listen(listen_sock_1, 1) < 0)
+	sin.sin_port = htons(port_nr);
+	if (bind(listen_sock, (struct sockaddr *)&sin, sizeof(sin)) < 0)
+		err(1, "binding to port %d", port_nr);
+	if (listen(listen_sock, 1) < 0)
 		err(1, "listen()");
+	return listen_sock;
+}
 
-	listen_sock_2 = socket(AF_INET, SOCK_STREAM, 0);
-	if (listen_sock_2 < 0)
-		err(1, "creating listening socket");
-	sin.sin_port = htons(port_nr_2);
-	if (bind(listen_sock_2, (struct sockaddr *)&sin, sizeof(sin)) < 0)
-		err(1, "binding to port %d", port_nr_2);
-	if (listen(listen_sock_2, 1) < 0)
-		err(1, "listen()");
+static int
+accept_one(int listen_sock)
+{
+	int fd;
 
-	*fd_1 = accept(listen_sock_1, NULL, NULL);
-	if (*fd_1 < 0)
+	fd = accept(listen_sock, NULL, NULL);
+	if (fd < 0)
 		err(1, "accept()");
-	close(listen_sock_1);
-	*fd_2 = accept(listen_sock_2, NULL, NULL);
-	if (*fd_2 < 0)
-		err(1, "accept()");
-	close(listen_sock_2);
+	close(listen_sock);
+	return fd;
+}
+
+/* --stdin and --file send their results to stdout, or with
+   --output-prefix to files called prefix_0, prefix_1 and so on, one
+   per partition, like the ones chunk makes. */
+static void
+open_partition_files(const char *prefix)
+{
+	char *path;
+	int x;
+
+	if (!prefix) {
+		if (nr_partitions > 1)
+			errx(1, "--partitions without a socket needs --output-prefix");
+		result_fds[0] = 1;
+		return;
+	}
+	for (x = 0; x < nr_partitions; x++) {
+		if (asprintf(&path, "%s_%d", prefix, x) < 0)
+			err(1, "asprintf");
+		result_fds[x] = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+		if (result_fds[x] < 0)
+			err(1, "creating %s", path);
+		free(path);
+	}
+}
+
+/* Input comes in on port_nr_1.  The results go out on port_nr_2, or
+   with --partitions, partition r goes out on port_nr_2 + r. */
+static void
+accept_on_ports(int port_nr_1, int port_nr_2, int *fd_1)
+{
+	int listen_socks[MAX_PARTITIONS];
+	int listen_sock_1;
+	int x;
+
+	listen_sock_1 = listen_on_port(port_nr_1);
+	for (x = 0; x < nr_partitions; x++)
+		listen_socks[x] = listen_on_port(port_nr_2 + x);
+
+	*fd_1 = accept_one(listen_sock_1);
+	for (x = 0; x < nr_partitions; x++) {
+		result_fds[x] = accept_one(listen_socks[x]);
+		/* A driver from before version 2 never sends a hello,
+		   so --wire 1 doesn't wait for one */
+		if (wire_version >= 2)
+			negotiate_wire_version(result_fds[x], x == 0);
+		else
+			unread_hello = true;
+	}
 }
 
 int
@@ -191,24 +1392,123 @@ main(int argc, char *argv[])
 {
 	unsigned initial_word_size;
 	unsigned word_end;
+	unsigned word_len;
 	volatile int sent_initial_word;
-	int idx;
+	int nr_threads;
+	bool use_mmap;
+	unsigned malloc_flags;
+	const char *output_prefix;
 
-	init_malloc(true);
+	start_ns = monotonic_ns();
+
+	nr_threads = 1;
+	use_mmap = false;
+	malloc_flags = MALLOC_BUMP;
+	output_prefix = NULL;
+	while (argc > 2) {
+		if (!strcmp(argv[1], "--mmap")) {
+			use_mmap = true;
+			argv++;
+			argc--;
+			continue;
+		}
+		if (!strcmp(argv[1], "--hugetlb")) {
+			malloc_flags |= MALLOC_HUGETLB;
+			argv++;
+			argc--;
+			continue;
+		}
+		if (!strcmp(argv[1], "--utf8")) {
+			wire_flags |= WIRE_UTF8;
+			argv++;
+			argc--;
+			continue;
+		}
+		if (!strcmp(argv[1], "--numa-local")) {
+			malloc_flags |= MALLOC_NUMA_LOCAL;
+			argv++;
+			argc--;
+			continue;
+		}
+		if (!strcmp(argv[1], "--threads")) {
+			nr_threads = atoi(argv[2]);
+			if (nr_threads < 1)
+				errx(1, "need at least one thread");
+		} else if (!strcmp(argv[1], "--min-count")) {
+			min_count = atoi(argv[2]);
+			if (min_count < 1)
+				errx(1, "--min-count must be at least 1");
+		} else if (!strcmp(argv[1], "--metrics")) {
+			metrics_file = argv[2];
+		} else if (!strcmp(argv[1], "--wire")) {
+			wire_version = atoi(argv[2]);
+			if (wire_version < 1 || wire_version > WIRE_VERSION)
+				errx(1, "can only speak wire versions 1 to %d",
+				     WIRE_VERSION);
+		} else if (!strcmp(argv[1], "--encoding")) {
+			wire_flags |= parse_wire_encoding(argv[2]);
+		} else if (!strcmp(argv[1], "--compress")) {
+			wire_flags |= parse_wire_compression(argv[2]);
+		} else if (!strcmp(argv[1], "--hash")) {
+			hash_function = parse_hash_function(argv[2]);
+		} else if (!strcmp(argv[1], "--hash-seed")) {
+			hash_seed = strtoull(argv[2], NULL, 0);
+		} else if (!strcmp(argv[1], "--partitions")) {
+			nr_partitions = atoi(argv[2]);
+			if (nr_partitions < 1 || nr_partitions > MAX_PARTITIONS)
+				errx(1, "can only do 1 to %d partitions",
+				     MAX_PARTITIONS);
+		} else if (!strcmp(argv[1], "--output-prefix")) {
+			output_prefix = argv[2];
+		} else if (!strcmp(argv[1], "--memory-limit")) {
+			memory_limit = (size_t)atoi(argv[2]) << 20;
+			if (memory_limit < MIN_SPILL_LIMIT)
+				errx(1, "--memory-limit is a number of megabytes, at least %lu",
+				     MIN_SPILL_LIMIT >> 20);
+		} else if (!strcmp(argv[1], "--spill-dir")) {
+			spill_dir = argv[2];
+		} else if (!strcmp(argv[1], "--load-table")) {
+			load_table = argv[2];
+		} else if (!strcmp(argv[1], "--save-table")) {
+			save_table = argv[2];
+		} else {
+			break;
+		}
+		argv += 2;
+		argc -= 2;
+	}
 
+	init_malloc(malloc_flags);
+	spill_limit = memory_limit;
+	if (!spill_dir)
+		spill_dir = getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp";
 	if (argc == 1)
-		errx(1, "need either --stdin or two port numbers");
+		errx(1, "need either --stdin, --file or two port numbers");
+	if (metrics_file)
+		atexit(write_metrics);
 	if (!strcmp(argv[1], "--stdin")) {
 		if (argc != 2)
 			errx(1, "don't want other arguments with --stdin mode");
 		rx_fd = 0;
-		tx_fd = 1;
+		local_input = true;
+		open_partition_files(output_prefix);
+	} else if (!strcmp(argv[1], "--file")) {
+		if (argc != 3)
+			errx(1, "--file wants just a file name");
+		rx_fd = open(argv[2], O_RDONLY);
+		if (rx_fd < 0)
+			err(1, "open %s", argv[2]);
+		local_input = true;
+		open_partition_files(output_prefix);
+		use_mmap = true;
+	} else if (save_table) {
+		errx(1, "--save-table needs --stdin or --file; save the driver's table instead");
 	} else if (!strcmp(argv[1], "--prepopulate")) {
 		int tmp;
 
 		if (argc != 4)
 			errx(1, "wrong number of arguments for prepopulate mode");
-		accept_on_ports(atol(argv[2]), atol(argv[3]), &rx_fd, &tx_fd);
+		accept_on_ports(atol(argv[2]), atol(argv[3]), &rx_fd);
 		tmp = open("/tmp/worker_dump.txt", O_RDWR | O_TRUNC | O_CREAT, 0666);
 		if (tmp < 0)
 			err(1, "open /tmp/worker_dump.txt");
@@ -235,10 +1535,45 @@ main(int argc, char *argv[])
 	} else {
 		if (argc != 3)
 			errx(1, "wrong number of arguments for non-stdin mode");
-		accept_on_ports(atol(argv[1]), atol(argv[2]), &rx_fd, &tx_fd);
+		accept_on_ports(atol(argv[1]), atol(argv[2]), &rx_fd);
 	}
 
-	set_nonblock(tx_fd);
+	if (wire_version < 2 && (wire_flags & WIRE_UTF8))
+		errx(1, "--utf8 needs wire version 2 or later");
+	if (wire_version < 2)
+		wire_flags = 0;
+	if (!(wire_flags & WIRE_DEFLATE))
+		wire_flags &= ~WIRE_DEFLATE_LEVEL_MASK;
+	if (wire_version < 3) {
+		hash_function = HASH_LEGACY;
+		hash_seed = 0;
+	}
+	init_tokenizer(wire_flags & WIRE_UTF8);
+	if (load_table)
+		word_table_load(&word_table, map_snapshot(load_table), 0,
+				NR_HASH_TABLE_SLOTS);
+	if (nr_partitions == 1)
+		open_stream(result_fds[0]);
+
+	if (wire_flags & WIRE_WORK_QUEUE) {
+		count_blocks();
+		send_table();
+		return 0;
+	}
+
+	if (use_mmap) {
+		if (count_mapped(nr_threads)) {
+			send_table();
+			return 0;
+		}
+		warnx("input isn't a regular file, so can't map it");
+	}
+
+	if (nr_threads > 1) {
+		count_with_threads(nr_threads);
+		send_table();
+		return 0;
+	}
 
 	if (setjmp(finished_buffer)) {
 		/* Hit EOF on stdin. */
@@ -246,23 +1581,13 @@ main(int argc, char *argv[])
 
 		if (!sent_initial_word) {
 			/* Can happen if the input is completely empty */
-			send_word((const unsigned char *)"", 0);
+			send_boundary_word((const unsigned char *)"", 0);
 		}
 
 		/* Send the trailer word */
-		send_word(rx_buffer + rx_buffer_used, rx_buffer_avail - rx_buffer_used);
-
-		for (idx = 0; idx < NR_HASH_TABLE_SLOTS; idx++) {
-			struct word *w;
-			for (w = hash_table[idx]; w; w = w->next) {
-				assert(w->hash % NR_HASH_TABLE_SLOTS == idx);
-				send_words(w);
-			}
-		}
-
-		flush_output();
+		send_boundary_word(rx_buffer + rx_buffer_used, rx_buffer_avail - rx_buffer_used);
 
-		close(tx_fd);
+		send_table();
 
 		return 0;
 	}
@@ -272,7 +1597,7 @@ main(int argc, char *argv[])
 	/* Find the first word. */
 find_first_word:
 	rx_buffer[rx_buffer_avail] = ' ';
-	for (initial_word_size = 0; !is_space(rx_buffer[initial_word_size]); initial_word_size++)
+	for (initial_word_size = 0; !is_break(rx_buffer[initial_word_size]); initial_word_size++)
 		;
 	if (initial_word_size == rx_buffer_avail &&
 	    rx_buffer_avail != RX_BUFFER_SIZE) {
@@ -280,7 +1605,7 @@ find_first_word:
 		goto find_first_word;
 	}
 
-	send_word(rx_buffer, initial_word_size);
+	send_boundary_word(rx_buffer, initial_word_size);
 	sent_initial_word = 1;
 	rx_buffer_used = initial_word_size;
 
@@ -290,29 +1615,34 @@ find_first_word:
 
 	skip_spaces:
 		rx_buffer[rx_buffer_avail] = 'X';
-		while (is_space(rx_buffer[rx_buffer_used]))
-			rx_buffer_used++;
+		rx_buffer_used = tok_skip_spaces(rx_buffer, rx_buffer_used);
 		if (rx_buffer_used == rx_buffer_avail) {
 			replenish_rx_buffer();
 			goto skip_spaces;
 		}
 
-		/* Find the next word. */
+		/* Find the next word, lower-casing it into
+		   word_buffer as we go.  rx_buffer itself is left
+		   alone so that the trailer word goes out as it
+		   appeared in the input. */
 	find_word:
 		rx_buffer[rx_buffer_avail] = ' ';
-		for (word_end = rx_buffer_used;
-		     !is_space(rx_buffer[word_end]);
-		     word_end++)
-			;
+		word_end = tok_fold_word(rx_buffer, rx_buffer_used, word_buffer,
+					 &word_len);
+		/* The buffer being full only means the word's too
+		   long for it if it starts at the beginning */
 		if (word_end == rx_buffer_avail &&
-		    rx_buffer_avail != RX_BUFFER_SIZE) {
+		    (rx_buffer_used || rx_buffer_avail != RX_BUFFER_SIZE)) {
 			replenish_rx_buffer();
 			goto find_word;
 		}
 
-		down_case(rx_buffer + rx_buffer_used, word_end - rx_buffer_used);
-
-		bump_word_counter(rx_buffer + rx_buffer_used, word_end - rx_buffer_used, 1);
+		/* Only in UTF-8 mode, when what looked like the start
+		   of a word at the end of the buffer was a space */
+		if (word_len) {
+			bump_word_counter(word_buffer, word_len, 1);
+			check_memory(&word_table);
+		}
 		rx_buffer_used = word_end;
 	}
 }
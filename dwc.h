@@ -1,17 +1,407 @@
+#include <sys/types.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/* The wire contract between worker and driver is that words come out
+   in ascending order of slot, hash % NR_HASH_TABLE_SLOTS.  The word
+   table is open-addressed and keeps its cells sorted by an order key
+   whose top bits are the slot, so walking the cells in order gives
+   that for free. */
+#define NR_HASH_TABLE_SLOTS 262143
+
+/* Wire protocol.  A version 1 stream from a worker is the initial
+   and trailer words followed by (count, word) entries, where a word
+   is a length and then the bytes.  From version 2 on, the stream
+   starts with a wire_header, whose magic can never be mistaken for a
+   version 1 word length, and each entry carries the word's 64-bit
+   hash between the count and the word, so the driver never has to
+   rehash it.  The slot is just hash % NR_HASH_TABLE_SLOTS, so it
+   isn't sent.  When the driver connects it sends a wire_header with
+   the highest version it wants on the results socket, and the worker
+   uses the lower of that and its own.
+
+   A wire_header goes on the wire as little-endian 32-bit fields,
+   and the seed as a little-endian 64-bit one, in the order they're
+   declared.  The rest of a plain stream is in the worker's byte
+   order.
+
+   The flags in the driver's wire_header are the encodings it would
+   like; the worker uses whichever of those it supports and says
+   which in its own header.  WIRE_COMPACT makes every count and
+   length a LEB128 varint, and leaves the hash out, so that an entry
+   is just a varint count, a varint length and the word.  The driver
+   hashes the words itself, which is the price of a stream around
+   half the size of the plain one, and a quarter smaller than version
+   1's.  Nothing else in it depends on byte order.  Front coding each
+   word against the previous one doesn't pay: neighbours in slot
+   order hardly ever share a prefix.
+
+   WIRE_WIDE_COUNTS lets a count in the plain encoding go over 32
+   bits.  Those are sent as a 32-bit zero, which no real count can
+   be, and then the count in 64 bits; every other count is still 32
+   bits, so asking for it costs nothing.  Varints don't need it.
+
+   WIRE_DEFLATE means that everything after the worker's wire_header
+   is a single zlib stream, compressed at the level in
+   WIRE_DEFLATE_LEVEL_MASK.  The driver inflates it as it arrives.
+
+   WIRE_WORK_QUEUE changes the input side rather than the results.
+   Instead of the driver pushing one chunk down the input socket, the
+   worker asks for blocks by writing a byte to it, and each request is
+   answered with a 32-bit length and then that many bytes of input.
+   A zero length means there's nothing left.  Blocks start and end on
+   word boundaries, so the worker's initial and trailer words are
+   always empty.
+
+   WIRE_CREDIT is flow control for the results.  After its
+   wire_header, the driver sends a stream of 32-bit slot numbers on
+   the results socket, each one replacing the last.  Once the worker
+   has sent an entry from a slot past the latest, it doesn't send
+   another until it's been told it can.  The first one comes straight
+   after the header.
+
+   WIRE_UTF8 means the input is UTF-8, and is split into words and
+   case folded as such; see init_tokenizer().  It isn't an encoding,
+   so a worker has to do what the driver asks, and the driver won't
+   take a stream which doesn't say it did.
+
+   Version 3 adds the hash function and seed to the end of the
+   wire_header, in both directions.  The worker hashes with whatever
+   the driver asked for and says so in its own header.  Before
+   version 3 the header stops at the flags, and the hash is always
+   HASH_LEGACY with a zero seed. */
+#define WIRE_MAGIC 0xff435744
+#define WIRE_VERSION 3
+#define WIRE_COMPACT 1
+#define WIRE_DEFLATE 4
+#define WIRE_WORK_QUEUE 8
+#define WIRE_WIDE_COUNTS 16
+#define WIRE_CREDIT 32
+#define WIRE_UTF8 64
+#define WIRE_DEFLATE_LEVEL_SHIFT 8
+#define WIRE_DEFLATE_LEVEL_MASK (15 << WIRE_DEFLATE_LEVEL_SHIFT)
+#define WIRE_FLAGS_SUPPORTED (WIRE_COMPACT | WIRE_DEFLATE |		\
+			      WIRE_DEFLATE_LEVEL_MASK |			\
+			      WIRE_WORK_QUEUE | WIRE_WIDE_COUNTS |	\
+			      WIRE_CREDIT | WIRE_UTF8)
+struct wire_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t flags;
+	/* Version 3 on */
+	uint32_t hash_function;
+	uint64_t hash_seed;
+};
+#define WIRE_HEADER_V2_SIZE 12
+#define WIRE_HEADER_V3_SIZE 24
+
+static inline size_t
+wire_header_size(uint32_t version)
+{
+	return version >= 3 ? WIRE_HEADER_V3_SIZE : WIRE_HEADER_V2_SIZE;
+}
+
+/* Returns the number of bytes used, at most 10 */
+static inline unsigned
+put_varint(unsigned char *buf, uint64_t v)
+{
+	unsigned n = 0;
+
+	while (v >= 0x80) {
+		buf[n++] = v | 0x80;
+		v >>= 7;
+	}
+	buf[n++] = v;
+	return n;
+}
+
+/* Returns VARINT_OK and moves *p past the varint if it's all there
+   before end.  Otherwise *p stays put, and it's VARINT_SHORT if the
+   rest might still turn up, or VARINT_BAD if it's too long to be
+   one. */
+#define VARINT_OK 0
+#define VARINT_SHORT 1
+#define VARINT_BAD 2
+static inline int
+get_varint(const unsigned char **p, const unsigned char *end, uint64_t *v)
+{
+	const unsigned char *q = *p;
+	unsigned shift = 0;
+
+	*v = 0;
+	while (q < end) {
+		if (shift >= 70)
+			return VARINT_BAD;
+		*v |= (uint64_t)(*q & 0x7f) << shift;
+		if (!(*q++ & 0x80)) {
+			*p = q;
+			return VARINT_OK;
+		}
+		shift += 7;
+	}
+	return VARINT_SHORT;
+}
+
+static inline void
+put_le32(unsigned char *buf, uint32_t v)
+{
+	unsigned x;
+
+	for (x = 0; x < 4; x++)
+		buf[x] = v >> (x * 8);
+}
+
+static inline uint32_t
+get_le32(const unsigned char *buf)
+{
+	uint32_t v = 0;
+	unsigned x;
+
+	for (x = 0; x < 4; x++)
+		v |= (uint32_t)buf[x] << (x * 8);
+	return v;
+}
+
+static inline void
+put_le64(unsigned char *buf, uint64_t v)
+{
+	unsigned x;
+
+	for (x = 0; x < 8; x++)
+		buf[x] = v >> (x * 8);
+}
+
+static inline uint64_t
+get_le64(const unsigned char *buf)
+{
+	uint64_t v = 0;
+	unsigned x;
+
+	for (x = 0; x < 8; x++)
+		v |= (uint64_t)buf[x] << (x * 8);
+	return v;
+}
+
+/* Lay out the first wire_header_size(h->version) bytes of h in buf,
+ * and back */
+static inline void
+put_wire_header(unsigned char *buf, const struct wire_header *h)
+{
+	put_le32(buf, h->magic);
+	put_le32(buf + 4, h->version);
+	put_le32(buf + 8, h->flags);
+	if (h->version < 3)
+		return;
+	put_le32(buf + 12, h->hash_function);
+	put_le64(buf + 16, h->hash_seed);
+}
+
+static inline void
+get_wire_header(const unsigned char *buf, struct wire_header *h)
+{
+	h->magic = get_le32(buf);
+	h->version = get_le32(buf + 4);
+	h->flags = get_le32(buf + 8);
+	h->hash_function = 0;
+	h->hash_seed = 0;
+	if (h->version < 3)
+		return;
+	h->hash_function = get_le32(buf + 12);
+	h->hash_seed = get_le64(buf + 16);
+}
+
+/* Sorted output file, written by driver --output-file and read by
+   dwc-lookup.  It starts with SORTED_MAGIC and then has the words in
+   memcmp() order, in blocks of SORTED_BLOCK_WORDS.  Within a block
+   each word is a varint count of bytes shared with the previous
+   word (always 0 for the first word in a block), a varint length of
+   the rest, the rest, and then a varint count.  After the blocks
+   comes the index, the file offset of each block, and then the
+   trailer: index offset, number of blocks, number of words, words per
+   block, flags and SORTED_MAGIC again.  Everything fixed-size is a
+   little-endian 64-bit integer.  SORTED_UTF8 in the flags means the
+   words were counted in UTF-8 mode, which dwc-lookup has to fold its
+   queries the same way for. */
+#define SORTED_MAGIC 0x3254524f53435744ull /* "DWCSORT2" */
+#define SORTED_BLOCK_WORDS 64
+#define SORTED_TRAILER_SIZE 48
+#define SORTED_UTF8 1
+
+/* Table snapshot, written by --save-table and read back by
+   --load-table, in both the worker and the driver.  It's a
+   snapshot_header, then every word in order key order, each a 64-bit
+   count, the 64-bit hash, a 32-bit length and then the word, like
+   the worker's run files.  Everything is in the host's byte order,
+   and the header's size is the size of the whole file.  The driver's
+   snapshots are the complete counts, boundary words and all; a
+   worker's only have what it sent as entries. */
+#define SNAPSHOT_MAGIC 0x3150414e53435744ull /* "DWCSNAP1" */
+#define SNAPSHOT_ENTRY_HEADER 20
+struct snapshot_header {
+	uint64_t magic;
+	uint32_t hash_function;
+	uint32_t utf8; /* tok_utf8 when it was counted */
+	uint64_t hash_seed;
+	uint64_t nr_words;
+	uint64_t size;
+};
+
 struct word {
-	unsigned long hash;
-	struct word *next;
-	unsigned counter;
+	uint64_t key;
+	uint64_t hash;
+	uint64_t counter;
+	unsigned char *word; /* NULL for an empty cell */
 	unsigned len;
-	unsigned char word[];
 };
 
-#define NR_HASH_TABLE_SLOTS 262143
-extern struct word * hash_table[NR_HASH_TABLE_SLOTS];
+struct word_table {
+	struct word *cells;
+	unsigned nr_cells; /* Including the overflow area at the end */
+	unsigned nr_used;
+	unsigned bits; /* 2^bits home cells */
+	/* Keys from base up to focus share the bottom half of the home
+	 * cells, and keys from focus on share the top half.  See
+	 * word_table_focus(). */
+	uint64_t base;
+	uint64_t focus;
+	unsigned lo_shift;
+	unsigned hi_shift;
+};
+
+static inline unsigned
+word_home(const struct word_table *t, uint64_t key)
+{
+	if (key >= t->focus)
+		return (1u << (t->bits - 1)) + ((key - t->focus) >> t->hi_shift);
+	if (key < t->base)
+		return 0;
+	return (key - t->base) >> t->lo_shift;
+}
+
+extern struct word_table word_table;
+
+#define for_each_word(t, w)						\
+	for ((w) = (t)->cells; (w) < (t)->cells + (t)->nr_cells; (w)++) \
+		if ((w)->word)
+
+static inline int
+word_slot(const struct word *w)
+{
+	return w->hash % NR_HASH_TABLE_SLOTS;
+}
+
+/* Partitioned runs split the slots into contiguous ranges, one per
+   reducer.  Partition r of n is slots partition_start(r, n) up to
+   but not including partition_start(r + 1, n).  Each reducer gets an
+   ordinary stream from every worker, initial and trailer words and
+   all, but with only its own slots in it. */
+static inline int
+partition_start(int r, int n)
+{
+	return (uint64_t)NR_HASH_TABLE_SLOTS * r / n;
+}
 
 void *bump_malloc(size_t s);
+uint64_t hash_word(const unsigned char *start, unsigned size);
+
+/* Which hash_word() uses.  Slot order is part of the wire contract,
+   so every worker and the driver have to agree on both. */
+#define HASH_LEGACY 0
+#define HASH_MIX 1
+#define NR_HASH_FUNCTIONS 2
+extern unsigned hash_function;
+extern uint64_t hash_seed;
+extern const char *const hash_function_names[NR_HASH_FUNCTIONS];
+unsigned parse_hash_function(const char *name);
+uint64_t order_key(uint64_t h);
 int bump_word_counter(const unsigned char *work, unsigned wordlen,
 		      unsigned count);
-void init_malloc(bool use_bump_allocator);
+int word_table_bump(struct word_table *t, const unsigned char *start,
+		    unsigned size, unsigned count);
+int word_table_add(struct word_table *t, uint64_t h,
+		   const unsigned char *start, unsigned size, uint64_t count);
+void word_table_merge(struct word_table *dst, struct word_table *src);
+struct word *word_table_seek(const struct word_table *t, int slot);
+void word_table_expire(struct word_table *t, int last_slot,
+		       void (*fn)(struct word *w));
+void word_table_focus(struct word_table *t, int lo, int hi);
+const struct snapshot_header *map_snapshot(const char *path);
+void word_table_load(struct word_table *t, const struct snapshot_header *s,
+		     int lo, int hi);
+struct snapshot_writer;
+struct snapshot_writer *snapshot_create(const char *path);
+void snapshot_add(struct snapshot_writer *sw, const struct word *w);
+void snapshot_finish(struct snapshot_writer *sw);
+void bump_free(void *p, size_t s);
+void bump_reset(void);
+/* init_malloc() flags.  Without MALLOC_BUMP, bump_malloc() is just
+ * calloc(), and the others don't do anything. */
+#define MALLOC_BUMP 1
+#define MALLOC_HUGETLB 2
+#define MALLOC_NUMA_LOCAL 4
+void init_malloc(unsigned flags);
+
+/* Always-on counters, cheap enough for the hot paths.  Each thread
+   counts into its own copy, and metrics_flush() adds that into the
+   process's totals, which metrics_print() writes out as the fields
+   of a JSON object. */
+struct metrics {
+	uint64_t bytes_received;
+	uint64_t bytes_sent;
+	uint64_t lookups;	/* words looked up in a word table */
+	uint64_t new_words;
+	uint64_t probes;	/* how far past their homes words were found */
+	uint64_t shifted;	/* cells moved up to make room for one */
+	uint64_t table_grows;
+	uint64_t arena_bytes;	/* mapped for bump_malloc() */
+	uint64_t arena_used;	/* asked for from bump_malloc() */
+	uint64_t arena_wasted;	/* padding, headers and abandoned tails */
+	uint64_t heap_bytes;	/* live from bump_malloc() without MALLOC_BUMP */
+	uint64_t table_bytes;	/* live word table cells */
+};
+extern __thread struct metrics metrics;
+void metrics_flush(void);
+void metrics_print(FILE *f);
+uint64_t monotonic_ns(void);
+uint32_t parse_wire_encoding(const char *name);
+uint32_t parse_wire_compression(const char *name);
 void set_nonblock(int fd);
+off_t next_word_boundary(int fd, off_t off, off_t size);
+
+static inline int
+is_space(unsigned char c)
+{
+	return !((c >= '0' && c <= '9') ||
+		 (c >= 'A' && c <= 'Z') ||
+		 (c >= 'a' && c <= 'z'));
+}
+
+/* Tokenizer.  Both scanners rely on the caller having put a sentinel
+   byte which terminates the scan somewhere in the buffer, and on
+   there being TOKENIZE_PAD readable bytes beyond it.  tok_fold_word
+   writes the lower-cased word to out, which may be overrun by up to
+   TOKENIZE_PAD bytes, and its length to *len.
+
+   With init_tokenizer(true) the input is UTF-8, words are made of
+   Unicode letters, marks and digits, and they're case folded.
+   Folding can make a word up to half as long again, so out needs to
+   be TOKENIZE_OUT_SIZE() of the longest word, and a word can come out
+   empty.  The worker and the driver have to agree on the mode, so
+   it's part of the wire protocol, as WIRE_UTF8. */
+#define TOKENIZE_PAD 32
+#define TOKENIZE_OUT_SIZE(n) ((n) + (n) / 2 + TOKENIZE_PAD)
+extern unsigned (*tok_skip_spaces)(const unsigned char *buf, unsigned pos);
+extern unsigned (*tok_fold_word)(const unsigned char *buf, unsigned pos,
+				 unsigned char *out, unsigned *len);
+extern bool tok_utf8; /* in common.c, so chunk doesn't need the rest */
+void init_tokenizer(bool utf8);
+
+/* Somewhere the input can be cut without changing what the words in
+ * it are.  In UTF-8 mode only ASCII will do, since any other byte
+ * might be part of a letter. */
+static inline int
+is_break(unsigned char c)
+{
+	return is_space(c) && (c < 0x80 || !tok_utf8);
+}
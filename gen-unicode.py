@@ -0,0 +1,84 @@
+#!/usr/bin/env python3
+# Generate unicode.h, the tables behind the tokenizer's UTF-8 mode:
+#
+#	./gen-unicode.py > unicode.h
+#
+# A word character is anything in one of the letter, mark or number
+# categories, and word characters are folded with simple (one code
+# point to one code point) case folding.  The data is whatever the
+# Python running this has, so the version goes in the output.
+import sys
+import unicodedata
+
+NR_CODE_POINTS = 0x110000
+LEAF = 16	# code points per leaf
+MID = 64	# leaves per middle block
+
+
+def fold(c):
+    for f in (c.casefold(), c.lower()):
+        if len(f) == 1:
+            return f
+    return c
+
+
+def props(cp):
+    if 0xd800 <= cp < 0xe000:
+        return 0
+    c = chr(cp)
+    if unicodedata.category(c)[0] not in 'LMN':
+        return 0
+    return (ord(fold(c)) - cp) * 2 | 1
+
+
+def dedup(items, size):
+    index = {}
+    ids = []
+    for x in range(0, len(items), size):
+        ids.append(index.setdefault(tuple(items[x:x + size]), len(index)))
+    return ids, sorted(index, key=index.get)
+
+
+def table(f, ctype, name, rows):
+    f.write('static const %s %s[%d]%s = {\n' %
+            (ctype, name, len(rows),
+             '[%d]' % len(rows[0]) if isinstance(rows[0], tuple) else ''))
+    if isinstance(rows[0], tuple):
+        for row in rows:
+            f.write('\t{%s},\n' % ', '.join(str(x) for x in row))
+    else:
+        for x in range(0, len(rows), 16):
+            f.write('\t%s,\n' % ', '.join(str(v) for v in rows[x:x + 16]))
+    f.write('};\n')
+
+
+def main():
+    f = sys.stdout
+    all_props = [props(cp) for cp in range(NR_CODE_POINTS)]
+    prop_values = sorted(set(all_props))
+    prop_ids = [prop_values.index(p) for p in all_props]
+    leaf_ids, leaves = dedup(prop_ids, LEAF)
+    top, mids = dedup(leaf_ids, MID)
+    assert len(prop_values) < 256 and len(leaves) < 65536 and len(mids) < 256
+
+    f.write('/* Generated by gen-unicode.py from Unicode %s.  Don\'t edit.\n'
+            '\n'
+            '   uni_props[] has bit 0 set for a word character, and the rest\n'
+            '   is what to add to the code point to fold its case.  Code point\n'
+            '   c\'s entry is\n'
+            '\n'
+            '\tuni_props[uni_leaf[uni_mid[uni_top[c >> %d]][(c >> %d) & %d]][c & %d]]\n'
+            '*/\n' %
+            (unicodedata.unidata_version,
+             (LEAF * MID).bit_length() - 1, LEAF.bit_length() - 1,
+             MID - 1, LEAF - 1))
+    f.write('#define UNI_LEAF_BITS %d\n' % (LEAF.bit_length() - 1))
+    f.write('#define UNI_MID_BITS %d\n' % (MID.bit_length() - 1))
+    f.write('#define UNI_WORD 1\n\n')
+    table(f, 'int32_t', 'uni_props', prop_values)
+    table(f, 'uint8_t', 'uni_leaf', leaves)
+    table(f, 'uint16_t', 'uni_mid', mids)
+    table(f, 'uint8_t', 'uni_top', top)
+
+
+main()
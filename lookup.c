@@ -0,0 +1,234 @@
+/* Look words up in a sorted output file written by driver
+   --output-file, or dump the whole thing back out as text in the
+   driver's usual format.  The file is mapped, and a lookup only
+   touches the first word of the blocks on its binary search path
+   plus the one block the word would be in.  Query words are folded
+   the way the file's were counted, so they can be given in any
+   case. */
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <err.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "dwc.h"
+
+static const unsigned char *file;
+static const unsigned char *index_start;
+static const unsigned char *blocks_end;
+static uint64_t nr_blocks;
+static uint64_t nr_words;
+static uint64_t block_words;
+
+/* The word currently being decoded.  Front coding means that it
+   has to be built up a block at a time. */
+static unsigned char *word;
+static size_t word_len;
+static size_t word_size;
+
+static void
+open_sorted(const char *path)
+{
+	struct stat st;
+	const unsigned char *trailer;
+	uint64_t index_offset;
+	uint64_t flags;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		err(1, "opening %s", path);
+	if (fstat(fd, &st) < 0)
+		err(1, "stat(%s)", path);
+	if (st.st_size < 8 + SORTED_TRAILER_SIZE)
+		errx(1, "%s is too short to be a sorted output file", path);
+	file = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (file == MAP_FAILED)
+		err(1, "mapping %s", path);
+	close(fd);
+
+	trailer = file + st.st_size - SORTED_TRAILER_SIZE;
+	if (get_le64(file) != SORTED_MAGIC ||
+	    get_le64(trailer + 40) != SORTED_MAGIC)
+		errx(1, "%s isn't a sorted output file", path);
+	index_offset = get_le64(trailer);
+	nr_blocks = get_le64(trailer + 8);
+	nr_words = get_le64(trailer + 16);
+	block_words = get_le64(trailer + 24);
+	flags = get_le64(trailer + 32);
+	if (flags & ~(uint64_t)SORTED_UTF8)
+		errx(1, "%s has unknown flags %llx", path,
+		     (unsigned long long)flags);
+	init_tokenizer(flags & SORTED_UTF8);
+	if (index_offset < 8 || !block_words ||
+	    index_offset + nr_blocks * 8 != st.st_size - SORTED_TRAILER_SIZE)
+		errx(1, "%s has a bad index", path);
+	index_start = file + index_offset;
+	blocks_end = index_start;
+}
+
+/* Decode the word at *p into word and word_len, and return its
+   count. */
+static uint64_t
+next_word(const unsigned char **p)
+{
+	uint64_t shared;
+	uint64_t rest;
+	uint64_t count;
+
+	if (get_varint(p, blocks_end, &shared) != VARINT_OK ||
+	    get_varint(p, blocks_end, &rest) != VARINT_OK ||
+	    shared > word_len ||
+	    rest > (uint64_t)(blocks_end - *p))
+		errx(1, "corrupt block");
+	if (shared + rest > word_size) {
+		word_size = shared + rest;
+		word = realloc(word, word_size);
+		if (!word)
+			err(1, "allocating word buffer");
+	}
+	memcpy(word + shared, *p, rest);
+	*p += rest;
+	word_len = shared + rest;
+	if (get_varint(p, blocks_end, &count) != VARINT_OK)
+		errx(1, "corrupt block");
+	return count;
+}
+
+static const unsigned char *
+block_start(uint64_t b)
+{
+	uint64_t offset = get_le64(index_start + b * 8);
+
+	if (offset >= (uint64_t)(blocks_end - file))
+		errx(1, "corrupt index");
+	word_len = 0;
+	return file + offset;
+}
+
+static int
+compare(const unsigned char *a, size_t a_len, const unsigned char *b,
+	size_t b_len)
+{
+	int r;
+
+	r = memcmp(a, b, a_len < b_len ? a_len : b_len);
+	if (r)
+		return r;
+	return (a_len > b_len) - (a_len < b_len);
+}
+
+/* Returns false if the word isn't there */
+static bool
+lookup(const unsigned char *key, size_t key_len, uint64_t *count)
+{
+	const unsigned char *p;
+	uint64_t lo;
+	uint64_t hi;
+	uint64_t mid;
+	uint64_t x;
+	uint64_t c;
+	int r;
+
+	if (!nr_blocks)
+		return false;
+
+	/* Find the last block whose first word is <= key */
+	lo = 0;
+	hi = nr_blocks;
+	while (hi - lo > 1) {
+		mid = lo + (hi - lo) / 2;
+		p = block_start(mid);
+		next_word(&p);
+		if (compare(word, word_len, key, key_len) <= 0)
+			lo = mid;
+		else
+			hi = mid;
+	}
+
+	p = block_start(lo);
+	for (x = lo * block_words; x < nr_words && x < (lo + 1) * block_words; x++) {
+		c = next_word(&p);
+		r = compare(word, word_len, key, key_len);
+		if (r == 0) {
+			*count = c;
+			return true;
+		}
+		if (r > 0)
+			break;
+	}
+	return false;
+}
+
+/* Fold query into a word the way the counting did.  Returns false if
+   it isn't exactly one word, since then it can't be in the file. */
+static bool
+lookup_query(const char *query, uint64_t *count)
+{
+	unsigned len = strlen(query);
+	unsigned char *buf;
+	unsigned char *folded;
+	unsigned folded_len;
+	bool found;
+
+	buf = malloc(len + 1 + TOKENIZE_PAD);
+	folded = malloc(TOKENIZE_OUT_SIZE(len));
+	if (!buf || !folded)
+		err(1, "allocating %u byte query", len);
+	memcpy(buf, query, len);
+	buf[len] = ' ';
+	found = tok_fold_word(buf, 0, folded, &folded_len) == len &&
+		folded_len &&
+		lookup(folded, folded_len, count);
+	free(buf);
+	free(folded);
+	return found;
+}
+
+static void
+dump(void)
+{
+	const unsigned char *p;
+	uint64_t x;
+	uint64_t c;
+
+	p = NULL;
+	for (x = 0; x < nr_words; x++) {
+		if (x % block_words == 0)
+			p = block_start(x / block_words);
+		c = next_word(&p);
+		printf("%16llu %.*s\n", (unsigned long long)c, (int)word_len, word);
+	}
+}
+
+int
+main(int argc, char *argv[])
+{
+	uint64_t count;
+	int missing;
+	int x;
+
+	if (argc == 3 && !strcmp(argv[1], "--dump")) {
+		open_sorted(argv[2]);
+		dump();
+		return 0;
+	}
+	if (argc < 3)
+		errx(1, "usage: dwc-lookup file word... or dwc-lookup --dump file");
+
+	open_sorted(argv[1]);
+	missing = 0;
+	for (x = 2; x < argc; x++) {
+		if (lookup_query(argv[x], &count)) {
+			printf("%16llu %s\n", (unsigned long long)count, argv[x]);
+		} else {
+			printf("%16d %s\n", 0, argv[x]);
+			missing = 1;
+		}
+	}
+	return missing;
+}
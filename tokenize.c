@@ -0,0 +1,340 @@
+/* Word tokenizer used by the worker's main scan loop, and by the
+   driver for boundary words.  Classifies a block of bytes at a time
+   into alnum/non-alnum bitmasks and folds case while copying the word
+   out, so that each input byte is only looked at once.  The
+   implementation is picked at start of day from what the CPU
+   supports. */
+#include <immintrin.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dwc.h"
+#include "unicode.h"
+
+unsigned (*tok_skip_spaces)(const unsigned char *buf, unsigned pos);
+unsigned (*tok_fold_word)(const unsigned char *buf, unsigned pos,
+			  unsigned char *out, unsigned *len);
+
+/* The ASCII scanners for UTF-8 mode to build on.  ascii_skip stops at
+ * bytes over 0x7f as well as at letters and digits. */
+static unsigned (*ascii_skip)(const unsigned char *buf, unsigned pos);
+static unsigned (*ascii_fold_word)(const unsigned char *buf, unsigned pos,
+				   unsigned char *out, unsigned *len);
+
+/* Scalar versions, for CPUs without SSE2 and as the reference
+ * definition of what a word is. */
+static unsigned
+skip_spaces_scalar(const unsigned char *buf, unsigned pos)
+{
+	while (is_space(buf[pos]))
+		pos++;
+	return pos;
+}
+
+static unsigned
+skip_ascii_scalar(const unsigned char *buf, unsigned pos)
+{
+	while (is_space(buf[pos]) && buf[pos] < 0x80)
+		pos++;
+	return pos;
+}
+
+static unsigned
+fold_word_scalar(const unsigned char *buf, unsigned pos, unsigned char *out,
+		 unsigned *len)
+{
+	unsigned start = pos;
+	unsigned char c;
+
+	while (!is_space(c = buf[pos])) {
+		if (c >= 'A' && c <= 'Z')
+			c = c - 'A' + 'a';
+		*out++ = c;
+		pos++;
+	}
+	*len = pos - start;
+	return pos;
+}
+
+/* SSE2: 16 bytes at a time.  There's no unsigned byte compare, so
+   range checks are done as min(x - lo, hi - lo) == x - lo. */
+#define SSE2_IN_RANGE(x, lo, n)						\
+	_mm_cmpeq_epi8(_mm_min_epu8(_mm_sub_epi8((x), _mm_set1_epi8(lo)), \
+				    _mm_set1_epi8((n) - 1)),		\
+		       _mm_sub_epi8((x), _mm_set1_epi8(lo)))
+
+static inline __attribute__((target("sse2"))) __m128i
+alnum_sse2(__m128i v)
+{
+	return _mm_or_si128(SSE2_IN_RANGE(v, '0', 10),
+			    SSE2_IN_RANGE(_mm_or_si128(v, _mm_set1_epi8(0x20)),
+					  'a', 26));
+}
+
+static __attribute__((target("sse2"))) unsigned
+skip_spaces_sse2(const unsigned char *buf, unsigned pos)
+{
+	unsigned mask;
+
+	while (1) {
+		mask = _mm_movemask_epi8(alnum_sse2(_mm_loadu_si128((const __m128i *)(buf + pos))));
+		if (mask)
+			return pos + __builtin_ctz(mask);
+		pos += 16;
+	}
+}
+
+/* The top bit is already what movemask picks out */
+static __attribute__((target("sse2"))) unsigned
+skip_ascii_sse2(const unsigned char *buf, unsigned pos)
+{
+	__m128i v;
+	unsigned mask;
+
+	while (1) {
+		v = _mm_loadu_si128((const __m128i *)(buf + pos));
+		mask = _mm_movemask_epi8(_mm_or_si128(alnum_sse2(v), v));
+		if (mask)
+			return pos + __builtin_ctz(mask);
+		pos += 16;
+	}
+}
+
+static __attribute__((target("sse2"))) unsigned
+fold_word_sse2(const unsigned char *buf, unsigned pos, unsigned char *out,
+	       unsigned *len)
+{
+	unsigned start = pos;
+	__m128i v;
+	__m128i upper;
+	unsigned mask;
+
+	while (1) {
+		v = _mm_loadu_si128((const __m128i *)(buf + pos));
+		upper = SSE2_IN_RANGE(v, 'A', 26);
+		v = _mm_or_si128(v, _mm_and_si128(upper, _mm_set1_epi8(0x20)));
+		_mm_storeu_si128((__m128i *)out, v);
+		mask = ~_mm_movemask_epi8(alnum_sse2(v)) & 0xffff;
+		if (mask) {
+			pos += __builtin_ctz(mask);
+			*len = pos - start;
+			return pos;
+		}
+		pos += 16;
+		out += 16;
+	}
+}
+
+/* AVX2: same thing, 32 bytes at a time. */
+#define AVX2_IN_RANGE(x, lo, n)						\
+	_mm256_cmpeq_epi8(_mm256_min_epu8(_mm256_sub_epi8((x), _mm256_set1_epi8(lo)), \
+					  _mm256_set1_epi8((n) - 1)),	\
+			  _mm256_sub_epi8((x), _mm256_set1_epi8(lo)))
+
+static inline __attribute__((target("avx2"))) __m256i
+alnum_avx2(__m256i v)
+{
+	return _mm256_or_si256(AVX2_IN_RANGE(v, '0', 10),
+			       AVX2_IN_RANGE(_mm256_or_si256(v, _mm256_set1_epi8(0x20)),
+					     'a', 26));
+}
+
+static __attribute__((target("avx2"))) unsigned
+skip_spaces_avx2(const unsigned char *buf, unsigned pos)
+{
+	unsigned mask;
+
+	while (1) {
+		mask = _mm256_movemask_epi8(alnum_avx2(_mm256_loadu_si256((const __m256i *)(buf + pos))));
+		if (mask)
+			return pos + __builtin_ctz(mask);
+		pos += 32;
+	}
+}
+
+static __attribute__((target("avx2"))) unsigned
+skip_ascii_avx2(const unsigned char *buf, unsigned pos)
+{
+	__m256i v;
+	unsigned mask;
+
+	while (1) {
+		v = _mm256_loadu_si256((const __m256i *)(buf + pos));
+		mask = _mm256_movemask_epi8(_mm256_or_si256(alnum_avx2(v), v));
+		if (mask)
+			return pos + __builtin_ctz(mask);
+		pos += 32;
+	}
+}
+
+static __attribute__((target("avx2"))) unsigned
+fold_word_avx2(const unsigned char *buf, unsigned pos, unsigned char *out,
+	       unsigned *len)
+{
+	unsigned start = pos;
+	__m256i v;
+	__m256i upper;
+	unsigned mask;
+
+	while (1) {
+		v = _mm256_loadu_si256((const __m256i *)(buf + pos));
+		upper = AVX2_IN_RANGE(v, 'A', 26);
+		v = _mm256_or_si256(v, _mm256_and_si256(upper, _mm256_set1_epi8(0x20)));
+		_mm256_storeu_si256((__m256i *)out, v);
+		mask = ~_mm256_movemask_epi8(alnum_avx2(v));
+		if (mask) {
+			pos += __builtin_ctz(mask);
+			*len = pos - start;
+			return pos;
+		}
+		pos += 32;
+		out += 32;
+	}
+}
+
+/* UTF-8 mode.  The ASCII scanners still do all the work on ASCII,
+   and only the byte they stop at gets looked at more closely, so
+   English text costs one extra compare per word.  Anything which
+   isn't well-formed UTF-8 is taken a byte at a time, as part of a
+   word and left as it is.  That way nothing gets lost, and a
+   character cut in half at the edge of a chunk stays with the
+   boundary word next to it, for the driver to put back together.
+   Since the sentinels are ASCII, a character cut short by one is
+   treated the same way. */
+
+/* The uni_props[] entry for the character starting at p, which has
+   to be a byte over 0x7f, and how many bytes it takes up. */
+static inline int32_t
+decode_utf8(const unsigned char *p, unsigned *len, uint32_t *cp)
+{
+	unsigned lo = 0x80, hi = 0xbf;
+	uint32_t c;
+
+	*len = 1;
+	if (p[0] >= 0xc2 && p[0] <= 0xdf) {
+		if (p[1] < 0x80 || p[1] > 0xbf)
+			return UNI_WORD;
+		c = (p[0] & 0x1f) << 6 | (p[1] & 0x3f);
+		*len = 2;
+	} else if (p[0] >= 0xe0 && p[0] <= 0xef) {
+		/* No overlong forms or surrogates */
+		if (p[0] == 0xe0)
+			lo = 0xa0;
+		else if (p[0] == 0xed)
+			hi = 0x9f;
+		if (p[1] < lo || p[1] > hi || p[2] < 0x80 || p[2] > 0xbf)
+			return UNI_WORD;
+		c = (p[0] & 0x0f) << 12 | (p[1] & 0x3f) << 6 | (p[2] & 0x3f);
+		*len = 3;
+	} else if (p[0] >= 0xf0 && p[0] <= 0xf4) {
+		/* Nor anything past U+10FFFF */
+		if (p[0] == 0xf0)
+			lo = 0x90;
+		else if (p[0] == 0xf4)
+			hi = 0x8f;
+		if (p[1] < lo || p[1] > hi || p[2] < 0x80 || p[2] > 0xbf ||
+		    p[3] < 0x80 || p[3] > 0xbf)
+			return UNI_WORD;
+		c = (p[0] & 0x07) << 18 | (p[1] & 0x3f) << 12 |
+			(p[2] & 0x3f) << 6 | (p[3] & 0x3f);
+		*len = 4;
+	} else {
+		return UNI_WORD;
+	}
+	*cp = c;
+	return uni_props[uni_leaf[uni_mid[uni_top[c >> (UNI_LEAF_BITS + UNI_MID_BITS)]]
+				  [(c >> UNI_LEAF_BITS) & ((1 << UNI_MID_BITS) - 1)]]
+			 [c & ((1 << UNI_LEAF_BITS) - 1)]];
+}
+
+static inline unsigned
+encode_utf8(uint32_t c, unsigned char *out)
+{
+	if (c < 0x80) {
+		out[0] = c;
+		return 1;
+	} else if (c < 0x800) {
+		out[0] = 0xc0 | c >> 6;
+		out[1] = 0x80 | (c & 0x3f);
+		return 2;
+	} else if (c < 0x10000) {
+		out[0] = 0xe0 | c >> 12;
+		out[1] = 0x80 | ((c >> 6) & 0x3f);
+		out[2] = 0x80 | (c & 0x3f);
+		return 3;
+	}
+	out[0] = 0xf0 | c >> 18;
+	out[1] = 0x80 | ((c >> 12) & 0x3f);
+	out[2] = 0x80 | ((c >> 6) & 0x3f);
+	out[3] = 0x80 | (c & 0x3f);
+	return 4;
+}
+
+static unsigned
+skip_spaces_utf8(const unsigned char *buf, unsigned pos)
+{
+	unsigned len;
+	uint32_t c;
+
+	while (1) {
+		pos = ascii_skip(buf, pos);
+		if (buf[pos] < 0x80 || (decode_utf8(buf + pos, &len, &c) & UNI_WORD))
+			return pos;
+		pos += len;
+	}
+}
+
+/* Can return an empty word, if it starts on a space which only
+ * turned out to be one once the rest of it had arrived. */
+static unsigned
+fold_word_utf8(const unsigned char *buf, unsigned pos, unsigned char *out,
+	       unsigned *len)
+{
+	unsigned used = 0;
+	unsigned n;
+	int32_t props;
+	uint32_t c;
+
+	while (1) {
+		pos = ascii_fold_word(buf, pos, out + used, &n);
+		used += n;
+		if (buf[pos] < 0x80)
+			break;
+		props = decode_utf8(buf + pos, &n, &c);
+		if (!(props & UNI_WORD))
+			break;
+		if (n == 1)
+			out[used++] = buf[pos];
+		else
+			used += encode_utf8(c + (props >> 1), out + used);
+		pos += n;
+	}
+	*len = used;
+	return pos;
+}
+
+void
+init_tokenizer(bool utf8)
+{
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		tok_skip_spaces = skip_spaces_avx2;
+		tok_fold_word = fold_word_avx2;
+		ascii_skip = skip_ascii_avx2;
+	} else if (__builtin_cpu_supports("sse2")) {
+		tok_skip_spaces = skip_spaces_sse2;
+		tok_fold_word = fold_word_sse2;
+		ascii_skip = skip_ascii_sse2;
+	} else {
+		tok_skip_spaces = skip_spaces_scalar;
+		tok_fold_word = fold_word_scalar;
+		ascii_skip = skip_ascii_scalar;
+	}
+	tok_utf8 = utf8;
+	if (utf8) {
+		ascii_fold_word = tok_fold_word;
+		tok_skip_spaces = skip_spaces_utf8;
+		tok_fold_word = fold_word_utf8;
+	}
+}
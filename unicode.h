@@ -0,0 +1,439 @@
+/* Generated by gen-unicode.py from Unicode 14.0.0.  Don't edit.
+
+   uni_props[] has bit 0 set for a word character, and the rest
+   is what to add to the code point to fold its case.  Code point
+   c's entry is
+
+	uni_props[uni_leaf[uni_mid[uni_top[c >> 10]][(c >> 4) & 63]][c & 15]]
+*/
+#define UNI_LEAF_BITS 4
+#define UNI_MID_BITS 6
+#define UNI_WORD 1
+
+static const int32_t uni_props[99] = {
+	-84637, -84629, -84615, -84613, -84609, -84563, -84559, -84521, -84515, -77727, -70767, -70663, -21629, -21565, -21563, -21559,
+	-21497, -21485, -21453, -16765, -16523, -15229, -15033, -14345, -12443, -12441, -12423, -12421, -12419, -12407, -12359, -7627,
+	-6015, -535, -389, -325, -259, -255, -251, -241, -223, -199, -193, -171, -147, -127, -119, -115,
+	-111, -107, -95, -59, -49, -43, -29, -17, -15, -13, 0, 1, 3, 5, 17, 31,
+	33, 57, 65, 69, 75, 77, 79, 81, 97, 127, 129, 139, 143, 159, 161, 233,
+	405, 407, 411, 413, 415, 419, 421, 423, 427, 429, 435, 437, 439, 1551, 1857, 14529,
+	21585, 21591, 70535,
+};
+static const uint8_t uni_leaf[285][16] = {
+	{58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58},
+	{59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 58, 58, 58, 58, 58, 58},
+	{58, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66},
+	{66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 58, 58, 58, 58, 58},
+	{58, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59},
+	{59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 58, 58, 58, 58, 58},
+	{58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 59, 58, 58, 58, 58, 58},
+	{58, 58, 59, 59, 58, 93, 58, 58, 58, 59, 59, 58, 59, 59, 59, 58},
+	{66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66},
+	{66, 66, 66, 66, 66, 66, 66, 58, 66, 66, 66, 66, 66, 66, 66, 59},
+	{59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59},
+	{59, 59, 59, 59, 59, 59, 59, 58, 59, 59, 59, 59, 59, 59, 59, 59},
+	{60, 59, 60, 59, 60, 59, 60, 59, 60, 59, 60, 59, 60, 59, 60, 59},
+	{59, 59, 60, 59, 60, 59, 60, 59, 59, 60, 59, 60, 59, 60, 59, 60},
+	{59, 60, 59, 60, 59, 60, 59, 60, 59, 59, 60, 59, 60, 59, 60, 59},
+	{60, 59, 60, 59, 60, 59, 60, 59, 39, 60, 59, 60, 59, 60, 59, 33},
+	{59, 86, 60, 59, 60, 59, 83, 60, 59, 82, 82, 60, 59, 59, 77, 80},
+	{81, 60, 59, 82, 84, 59, 87, 85, 60, 59, 59, 59, 87, 88, 59, 89},
+	{60, 59, 60, 59, 60, 59, 91, 60, 59, 91, 59, 59, 60, 59, 91, 60},
+	{59, 90, 90, 60, 59, 60, 59, 92, 60, 59, 59, 59, 60, 59, 59, 59},
+	{59, 59, 59, 59, 61, 60, 59, 61, 60, 59, 61, 60, 59, 60, 59, 60},
+	{59, 60, 59, 60, 59, 60, 59, 60, 59, 60, 59, 60, 59, 59, 60, 59},
+	{59, 61, 60, 59, 60, 59, 42, 48, 60, 59, 60, 59, 60, 59, 60, 59},
+	{36, 59, 60, 59, 60, 59, 60, 59, 60, 59, 60, 59, 60, 59, 60, 59},
+	{60, 59, 60, 59, 59, 59, 59, 59, 59, 59, 97, 60, 59, 35, 96, 59},
+	{59, 60, 59, 34, 75, 76, 60, 59, 60, 59, 60, 59, 60, 59, 60, 59},
+	{59, 59, 58, 58, 58, 58, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59},
+	{59, 59, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58},
+	{59, 59, 59, 59, 59, 58, 58, 58, 58, 58, 58, 58, 59, 58, 59, 58},
+	{59, 59, 59, 59, 59, 79, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59},
+	{60, 59, 60, 59, 59, 58, 60, 59, 58, 58, 59, 59, 59, 59, 58, 79},
+	{58, 58, 58, 58, 58, 58, 69, 58, 68, 68, 68, 58, 74, 58, 73, 73},
+	{59, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66},
+	{66, 66, 58, 66, 66, 66, 66, 66, 66, 66, 66, 66, 59, 59, 59, 59},
+	{59, 59, 60, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 62},
+	{51, 52, 59, 59, 59, 54, 53, 59, 60, 59, 60, 59, 60, 59, 60, 59},
+	{49, 50, 59, 59, 46, 45, 58, 60, 59, 57, 60, 59, 59, 36, 36, 36},
+	{78, 78, 78, 78, 78, 78, 78, 78, 78, 78, 78, 78, 78, 78, 78, 78},
+	{60, 59, 58, 59, 59, 59, 59, 59, 59, 59, 60, 59, 60, 59, 60, 59},
+	{63, 60, 59, 60, 59, 60, 59, 60, 59, 60, 59, 60, 59, 60, 59, 59},
+	{58, 72, 72, 72, 72, 72, 72, 72, 72, 72, 72, 72, 72, 72, 72, 72},
+	{72, 72, 72, 72, 72, 72, 72, 72, 72, 72, 72, 72, 72, 72, 72, 72},
+	{72, 72, 72, 72, 72, 72, 72, 58, 58, 59, 58, 58, 58, 58, 58, 58},
+	{59, 59, 59, 59, 59, 59, 59, 59, 59, 58, 58, 58, 58, 58, 58, 58},
+	{59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 58, 59},
+	{58, 59, 59, 58, 59, 59, 58, 59, 58, 58, 58, 58, 58, 58, 58, 58},
+	{59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 58, 58, 58, 58, 59},
+	{59, 59, 59, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58},
+	{59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 58, 58, 58, 58, 59, 59},
+	{59, 59, 59, 59, 58, 59, 59, 59, 59, 59, 59, 59, 59, 58, 58, 59},
+	{59, 59, 59, 59, 59, 59, 59, 59, 59, 58, 59, 59, 59, 59, 59, 59},
+	{59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 58, 58, 59},
+	{59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 58, 58, 59, 59, 59},
+	{59, 59, 59, 59, 59, 59, 58, 58, 58, 58, 59, 58, 58, 59, 58, 58},
+	{59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 58, 58},
+	{59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 58, 58, 58, 58},
+	{59, 59, 59, 59, 59, 59, 59, 59, 58, 59, 59, 59, 59, 59, 59, 58},
+	{58, 58, 58, 58, 58, 58, 58, 58, 59, 59, 59, 59, 59, 59, 59, 59},
+	{59, 59, 58, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59},
+	{59, 59, 59, 59, 58, 58, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59},
+	{59, 58, 58, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59},
+	{59, 58, 59, 58, 58, 58, 59, 59, 59, 59, 58, 58, 59, 59, 59, 59},
+	{59, 59, 59, 59, 59, 58, 58, 59, 59, 58, 58, 59, 59, 59, 59, 58},
+	{58, 58, 58, 58, 58, 58, 58, 59, 58, 58, 58, 58, 59, 59, 58, 59},
+	{59, 59, 58, 58, 59, 59, 59, 59, 59, 59, 58, 58, 59, 58, 59, 58},
+	{58, 59, 59, 59, 58, 59, 59, 59, 59, 59, 59, 58, 58, 58, 58, 59},
+	{59, 58, 59, 59, 58, 59, 59, 58, 59, 59, 58, 58, 59, 58, 59, 59},
+	{59, 59, 59, 58, 58, 58, 58, 59, 59, 58, 58, 59, 59, 59, 58, 58},
+	{58, 59, 58, 58, 58, 58, 58, 58, 58, 59, 59, 59, 59, 58, 59, 58},
+	{58, 58, 58, 58, 58, 58, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59},
+	{59, 59, 59, 59, 59, 59, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58},
+	{58, 59, 59, 59, 58, 59, 59, 59, 59, 59, 59, 59, 59, 59, 58, 59},
+	{59, 58, 59, 59, 58, 59, 59, 59, 59, 59, 58, 58, 59, 59, 59, 59},
+	{59, 59, 59, 59, 59, 59, 58, 59, 59, 59, 58, 59, 59, 59, 58, 58},
+	{59, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58},
+	{58, 58, 58, 58, 58, 58, 58, 58, 58, 59, 59, 59, 59, 59, 59, 59},
+	{58, 59, 59, 59, 58, 59, 59, 59, 59, 59, 59, 59, 59, 58, 58, 59},
+	{59, 59, 59, 59, 59, 58, 58, 59, 59, 58, 58, 59, 59, 59, 58, 58},
+	{58, 58, 58, 58, 58, 59, 59, 59, 58, 58, 58, 58, 59, 59, 58, 59},
+	{58, 59, 59, 59, 59, 59, 59, 59, 58, 58, 58, 58, 58, 58, 58, 58},
+	{58, 58, 59, 59, 58, 59, 59, 59, 59, 59, 59, 58, 58, 58, 59, 59},
+	{59, 58, 59, 59, 59, 59, 58, 58, 58, 59, 59, 58, 59, 58, 59, 59},
+	{58, 58, 58, 59, 59, 58, 58, 58, 59, 59, 59, 58, 58, 58, 59, 59},
+	{59, 59, 59, 58, 58, 58, 59, 59, 59, 58, 59, 59, 59, 59, 58, 58},
+	{59, 58, 58, 58, 58, 58, 58, 59, 58, 58, 58, 58, 58, 58, 58, 58},
+	{59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 58, 59, 59},
+	{59, 58, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59},
+	{59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 58, 58, 59, 59, 59, 59},
+	{59, 59, 59, 59, 59, 58, 59, 59, 59, 58, 59, 59, 59, 59, 58, 58},
+	{58, 58, 58, 58, 58, 59, 59, 58, 59, 59, 59, 58, 58, 59, 58, 58},
+	{58, 58, 58, 58, 58, 58, 58, 58, 59, 59, 59, 59, 59, 59, 59, 58},
+	{59, 59, 59, 59, 58, 59, 59, 59, 59, 59, 59, 59, 59, 58, 59, 59},
+	{59, 59, 59, 59, 58, 59, 59, 59, 59, 59, 58, 58, 59, 59, 59, 59},
+	{58, 58, 58, 58, 58, 59, 59, 58, 58, 58, 58, 58, 58, 59, 59, 58},
+	{58, 59, 59, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58},
+	{59, 59, 59, 59, 59, 58, 59, 59, 59, 58, 59, 59, 59, 59, 59, 58},
+	{58, 58, 58, 58, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59},
+	{58, 59, 59, 59, 58, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59},
+	{59, 59, 59, 59, 59, 59, 59, 58, 58, 58, 59, 59, 59, 59, 59, 59},
+	{59, 59, 58, 59, 59, 59, 59, 59, 59, 59, 59, 59, 58, 59, 58, 58},
+	{59, 59, 59, 59, 59, 59, 59, 58, 58, 58, 59, 58, 58, 58, 58, 59},
+	{59, 59, 59, 59, 59, 58, 59, 58, 59, 59, 59, 59, 59, 59, 59, 59},
+	{58, 58, 59, 59, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58},
+	{59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 58},
+	{58, 59, 59, 58, 59, 58, 59, 59, 59, 59, 59, 58, 59, 59, 59, 59},
+	{59, 59, 59, 59, 58, 59, 58, 59, 59, 59, 59, 59, 59, 59, 59, 59},
+	{59, 59, 59, 59, 59, 58, 59, 58, 59, 59, 59, 59, 59, 59, 58, 58},
+	{58, 58, 58, 58, 58, 58, 58, 58, 59, 59, 58, 58, 58, 58, 58, 58},
+	{59, 59, 59, 59, 58, 59, 58, 59, 58, 59, 58, 58, 58, 58, 59, 59},
+	{59, 59, 59, 59, 59, 59, 59, 59, 58, 59, 59, 59, 59, 59, 59, 59},
+	{59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 58, 58, 58},
+	{59, 59, 59, 59, 59, 58, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59},
+	{58, 58, 58, 58, 58, 58, 59, 58, 58, 58, 58, 58, 58, 58, 58, 58},
+	{95, 95, 95, 95, 95, 95, 95, 95, 95, 95, 95, 95, 95, 95, 95, 95},
+	{95, 95, 95, 95, 95, 95, 58, 95, 58, 58, 58, 58, 58, 95, 58, 58},
+	{59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 58, 59, 59, 59, 59},
+	{59, 59, 59, 59, 59, 59, 59, 59, 59, 58, 59, 59, 59, 59, 58, 58},
+	{59, 59, 59, 59, 59, 59, 59, 58, 59, 58, 59, 59, 59, 59, 58, 58},
+	{59, 58, 59, 59, 59, 59, 58, 58, 59, 59, 59, 59, 59, 59, 59, 58},
+	{59, 58, 59, 59, 59, 59, 58, 58, 59, 59, 59, 59, 59, 59, 59, 59},
+	{59, 59, 59, 59, 59, 59, 58, 58, 56, 56, 56, 56, 56, 56, 58, 58},
+	{59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 58, 58, 58, 59, 59},
+	{59, 59, 59, 59, 59, 59, 58, 58, 58, 58, 58, 58, 58, 58, 58, 59},
+	{59, 59, 59, 59, 59, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58},
+	{59, 59, 59, 59, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58},
+	{59, 58, 59, 59, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58},
+	{59, 59, 59, 59, 58, 58, 58, 59, 58, 58, 58, 58, 59, 59, 58, 58},
+	{58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 59, 59, 59, 58, 59},
+	{58, 58, 58, 58, 58, 58, 58, 59, 58, 58, 58, 58, 58, 58, 58, 58},
+	{58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 59, 59, 59, 59, 59},
+	{59, 59, 59, 59, 59, 59, 59, 59, 58, 58, 58, 58, 58, 58, 58, 58},
+	{59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 58, 58, 58, 59, 59, 59},
+	{24, 25, 26, 28, 28, 27, 29, 30, 98, 58, 58, 58, 58, 58, 58, 58},
+	{32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32},
+	{32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 58, 58, 32, 32, 32},
+	{59, 59, 59, 58, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59},
+	{60, 59, 60, 59, 60, 59, 59, 59, 59, 59, 59, 47, 59, 59, 21, 59},
+	{59, 59, 59, 59, 59, 59, 59, 59, 56, 56, 56, 56, 56, 56, 56, 56},
+	{59, 59, 59, 59, 59, 59, 59, 59, 58, 56, 58, 56, 58, 56, 58, 56},
+	{59, 59, 59, 59, 59, 58, 59, 59, 56, 56, 44, 44, 55, 58, 23, 58},
+	{58, 58, 59, 59, 59, 58, 59, 59, 43, 43, 43, 43, 55, 58, 58, 58},
+	{59, 59, 59, 59, 58, 58, 59, 59, 56, 56, 41, 41, 58, 58, 58, 58},
+	{59, 59, 59, 59, 59, 59, 59, 59, 56, 56, 40, 40, 57, 58, 58, 58},
+	{58, 58, 59, 59, 59, 58, 59, 59, 37, 37, 38, 38, 55, 58, 58, 58},
+	{59, 59, 58, 58, 59, 59, 59, 59, 59, 59, 58, 58, 58, 58, 58, 59},
+	{58, 58, 59, 58, 58, 58, 58, 59, 58, 58, 59, 59, 59, 59, 59, 59},
+	{59, 59, 59, 59, 58, 59, 58, 58, 58, 59, 59, 59, 59, 59, 58, 58},
+	{58, 58, 58, 58, 59, 58, 22, 58, 59, 58, 19, 20, 59, 59, 58, 59},
+	{59, 59, 65, 59, 59, 59, 59, 59, 59, 59, 58, 58, 59, 59, 59, 59},
+	{58, 58, 58, 58, 58, 59, 59, 59, 59, 59, 58, 58, 58, 58, 59, 58},
+	{64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64},
+	{59, 59, 59, 60, 59, 59, 59, 59, 59, 59, 58, 58, 58, 58, 58, 58},
+	{58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 59, 59, 59, 59, 59, 59},
+	{60, 59, 17, 31, 18, 59, 59, 60, 59, 60, 59, 60, 59, 15, 16, 13},
+	{14, 59, 60, 59, 59, 60, 59, 59, 59, 59, 59, 59, 59, 59, 12, 12},
+	{60, 59, 60, 59, 59, 58, 58, 58, 58, 58, 58, 60, 59, 60, 59, 59},
+	{59, 59, 60, 59, 58, 58, 58, 58, 58, 58, 58, 58, 58, 59, 58, 58},
+	{59, 59, 59, 59, 59, 59, 58, 59, 58, 58, 58, 58, 58, 59, 58, 58},
+	{59, 59, 59, 59, 59, 59, 59, 59, 58, 58, 58, 58, 58, 58, 58, 59},
+	{58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 59},
+	{59, 59, 59, 59, 59, 59, 59, 58, 58, 58, 58, 58, 58, 58, 58, 58},
+	{59, 59, 59, 59, 59, 59, 59, 58, 59, 59, 59, 59, 59, 59, 59, 58},
+	{58, 58, 58, 58, 58, 59, 59, 59, 58, 58, 58, 58, 58, 58, 58, 58},
+	{58, 59, 59, 59, 59, 59, 58, 58, 59, 59, 59, 59, 59, 58, 58, 58},
+	{59, 59, 59, 59, 59, 59, 59, 58, 58, 59, 59, 58, 58, 59, 59, 59},
+	{58, 58, 58, 58, 58, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59},
+	{58, 58, 59, 59, 59, 59, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58},
+	{60, 59, 60, 59, 60, 59, 60, 59, 60, 59, 60, 59, 60, 59, 59, 59},
+	{59, 59, 59, 58, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 58, 59},
+	{60, 59, 60, 59, 60, 59, 60, 59, 60, 59, 60, 59, 59, 59, 59, 59},
+	{58, 58, 58, 58, 58, 58, 58, 59, 59, 59, 59, 59, 59, 59, 59, 59},
+	{58, 58, 60, 59, 60, 59, 60, 59, 60, 59, 60, 59, 60, 59, 60, 59},
+	{59, 59, 60, 59, 60, 59, 60, 59, 60, 59, 60, 59, 60, 59, 60, 59},
+	{59, 59, 59, 59, 59, 59, 59, 59, 59, 60, 59, 60, 59, 11, 60, 59},
+	{60, 59, 60, 59, 60, 59, 60, 59, 59, 58, 58, 60, 59, 6, 59, 59},
+	{60, 59, 60, 59, 59, 59, 60, 59, 60, 59, 60, 59, 60, 59, 60, 59},
+	{60, 59, 60, 59, 60, 59, 60, 59, 60, 59, 2, 0, 1, 4, 2, 59},
+	{8, 5, 7, 94, 60, 59, 60, 59, 60, 59, 60, 59, 60, 59, 60, 59},
+	{60, 59, 60, 59, 50, 3, 10, 60, 59, 60, 59, 58, 58, 58, 58, 58},
+	{60, 59, 58, 59, 58, 59, 60, 59, 60, 59, 58, 58, 58, 58, 58, 58},
+	{58, 58, 59, 59, 59, 60, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59},
+	{59, 59, 59, 59, 59, 59, 59, 59, 58, 58, 58, 58, 59, 58, 58, 58},
+	{59, 59, 59, 59, 59, 59, 59, 59, 58, 58, 58, 59, 58, 59, 59, 59},
+	{59, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 59},
+	{58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 59, 59, 59, 58, 58},
+	{58, 58, 59, 59, 59, 59, 59, 58, 58, 58, 58, 58, 58, 58, 58, 58},
+	{58, 59, 59, 59, 59, 59, 59, 58, 58, 59, 59, 59, 59, 59, 59, 58},
+	{58, 59, 59, 59, 59, 59, 59, 58, 58, 58, 58, 58, 58, 58, 58, 58},
+	{9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9},
+	{59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 58, 59, 59, 58, 58},
+	{59, 59, 59, 59, 59, 59, 59, 58, 58, 58, 58, 59, 59, 59, 59, 59},
+	{58, 58, 58, 59, 59, 59, 59, 59, 58, 58, 58, 58, 58, 59, 59, 59},
+	{59, 59, 59, 59, 59, 59, 59, 58, 59, 59, 59, 59, 59, 58, 59, 58},
+	{59, 59, 58, 59, 59, 58, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59},
+	{58, 58, 58, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59},
+	{58, 58, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59},
+	{58, 58, 59, 59, 59, 59, 59, 59, 58, 58, 59, 59, 59, 59, 59, 59},
+	{58, 58, 59, 59, 59, 59, 59, 59, 58, 58, 59, 59, 59, 58, 58, 58},
+	{59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 58, 59, 59, 59},
+	{59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 58, 59, 59, 58, 59},
+	{58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 59, 59, 58, 58, 58, 58},
+	{58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 59, 58, 58},
+	{59, 59, 59, 59, 58, 58, 58, 58, 58, 58, 58, 58, 58, 59, 59, 59},
+	{59, 59, 59, 59, 58, 58, 58, 58, 59, 59, 59, 59, 59, 59, 59, 59},
+	{58, 59, 59, 59, 59, 59, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58},
+	{71, 71, 71, 71, 71, 71, 71, 71, 71, 71, 71, 71, 71, 71, 71, 71},
+	{71, 71, 71, 71, 71, 71, 71, 71, 59, 59, 59, 59, 59, 59, 59, 59},
+	{71, 71, 71, 71, 58, 58, 58, 58, 59, 59, 59, 59, 59, 59, 59, 59},
+	{70, 70, 70, 70, 70, 70, 70, 70, 70, 70, 70, 58, 70, 70, 70, 70},
+	{70, 70, 70, 58, 70, 70, 58, 59, 59, 59, 59, 59, 59, 59, 59, 59},
+	{59, 59, 58, 59, 59, 59, 59, 59, 59, 59, 58, 59, 59, 58, 58, 58},
+	{59, 59, 59, 59, 59, 59, 58, 59, 59, 59, 59, 59, 59, 59, 59, 59},
+	{59, 58, 59, 59, 59, 59, 59, 59, 59, 59, 59, 58, 58, 58, 58, 58},
+	{59, 59, 59, 59, 59, 59, 58, 58, 59, 58, 59, 59, 59, 59, 59, 59},
+	{59, 59, 59, 59, 59, 59, 58, 59, 59, 58, 58, 58, 59, 58, 58, 59},
+	{59, 59, 59, 59, 59, 59, 58, 58, 59, 59, 59, 59, 59, 59, 59, 59},
+	{59, 59, 59, 59, 59, 59, 59, 58, 58, 59, 59, 59, 59, 59, 59, 59},
+	{59, 59, 59, 58, 59, 59, 58, 58, 58, 58, 58, 59, 59, 59, 59, 59},
+	{59, 59, 59, 59, 59, 59, 59, 59, 58, 58, 58, 58, 59, 59, 59, 59},
+	{59, 59, 59, 59, 58, 59, 59, 58, 58, 58, 58, 58, 59, 59, 59, 59},
+	{59, 59, 59, 59, 58, 59, 59, 59, 58, 59, 59, 59, 59, 59, 59, 59},
+	{59, 59, 59, 59, 59, 59, 58, 58, 59, 59, 59, 58, 58, 58, 58, 59},
+	{59, 59, 59, 58, 58, 58, 58, 58, 59, 59, 59, 59, 59, 59, 59, 59},
+	{74, 74, 74, 74, 74, 74, 74, 74, 74, 74, 74, 74, 74, 74, 74, 74},
+	{74, 74, 74, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58},
+	{59, 59, 59, 58, 58, 58, 58, 58, 58, 58, 59, 59, 59, 59, 59, 59},
+	{59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 58, 59, 59, 58, 58, 58},
+	{58, 58, 59, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58},
+	{58, 58, 58, 58, 59, 59, 59, 59, 58, 58, 58, 58, 58, 58, 58, 58},
+	{59, 59, 59, 59, 58, 58, 59, 58, 58, 58, 58, 58, 58, 58, 58, 58},
+	{59, 59, 59, 59, 59, 58, 58, 58, 58, 59, 59, 59, 59, 58, 59, 59},
+	{59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 58, 59, 58, 58, 58},
+	{59, 59, 59, 59, 59, 59, 59, 59, 58, 58, 58, 58, 58, 58, 59, 58},
+	{59, 59, 59, 59, 59, 59, 59, 58, 59, 58, 59, 59, 59, 59, 58, 59},
+	{59, 58, 59, 59, 58, 59, 59, 59, 59, 59, 58, 59, 59, 59, 59, 59},
+	{59, 58, 58, 58, 58, 58, 58, 59, 58, 58, 58, 58, 58, 59, 59, 59},
+	{59, 59, 59, 59, 58, 58, 59, 59, 59, 59, 59, 59, 59, 58, 58, 58},
+	{59, 59, 59, 59, 59, 59, 58, 59, 58, 58, 58, 58, 58, 58, 58, 58},
+	{58, 58, 58, 58, 58, 58, 58, 58, 59, 59, 59, 59, 59, 59, 58, 58},
+	{59, 58, 58, 58, 59, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58},
+	{59, 59, 59, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 59},
+	{59, 59, 59, 59, 59, 59, 59, 58, 58, 59, 58, 58, 59, 59, 59, 59},
+	{59, 59, 59, 59, 58, 59, 59, 58, 59, 59, 59, 59, 59, 59, 59, 59},
+	{59, 59, 59, 59, 59, 59, 58, 59, 59, 58, 58, 59, 59, 59, 59, 59},
+	{59, 59, 59, 59, 59, 59, 59, 59, 58, 58, 59, 59, 59, 59, 59, 59},
+	{59, 59, 58, 59, 59, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58},
+	{59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 58, 58, 58, 59, 58, 58},
+	{59, 59, 59, 59, 59, 59, 59, 58, 59, 59, 58, 59, 59, 59, 59, 59},
+	{59, 59, 59, 59, 59, 59, 59, 58, 58, 58, 59, 58, 59, 59, 58, 59},
+	{59, 59, 59, 59, 59, 59, 58, 59, 59, 58, 59, 59, 59, 59, 59, 59},
+	{59, 59, 58, 59, 59, 59, 59, 59, 59, 58, 58, 58, 58, 58, 58, 58},
+	{59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 58, 59, 59, 59, 59, 59},
+	{59, 59, 59, 59, 59, 59, 59, 59, 58, 58, 58, 58, 58, 59, 59, 59},
+	{59, 59, 59, 59, 58, 59, 59, 59, 59, 59, 59, 59, 58, 59, 59, 58},
+	{59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 58, 58, 58, 59, 59, 58},
+	{58, 58, 58, 58, 58, 59, 59, 59, 59, 59, 58, 58, 58, 59, 59, 59},
+	{59, 59, 59, 58, 58, 58, 58, 58, 58, 58, 58, 59, 59, 59, 59, 59},
+	{59, 59, 59, 58, 58, 59, 59, 59, 59, 59, 59, 59, 58, 58, 58, 58},
+	{58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 59, 59, 59, 59, 58, 58},
+	{58, 58, 59, 59, 59, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58},
+	{58, 58, 59, 58, 58, 59, 59, 58, 58, 59, 59, 59, 59, 58, 59, 59},
+	{59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 58, 59, 58, 59, 59, 59},
+	{59, 59, 59, 59, 58, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59},
+	{59, 59, 59, 59, 59, 59, 58, 59, 59, 59, 59, 58, 58, 59, 59, 59},
+	{59, 59, 59, 59, 59, 58, 59, 59, 59, 59, 59, 59, 59, 58, 59, 59},
+	{59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 58, 59, 59, 59, 59, 58},
+	{59, 59, 59, 59, 59, 58, 59, 58, 58, 58, 59, 59, 59, 59, 59, 59},
+	{59, 59, 59, 58, 59, 59, 59, 59, 59, 59, 59, 59, 58, 58, 59, 59},
+	{58, 58, 58, 58, 58, 59, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58},
+	{58, 58, 58, 58, 59, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58},
+	{59, 59, 59, 59, 59, 59, 59, 59, 59, 58, 58, 59, 59, 59, 59, 59},
+	{59, 59, 58, 59, 59, 58, 59, 59, 59, 59, 59, 58, 58, 58, 58, 58},
+	{59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 58, 58, 58, 58, 59, 58},
+	{59, 59, 59, 59, 59, 59, 59, 58, 59, 59, 59, 59, 58, 59, 59, 58},
+	{59, 59, 59, 59, 59, 58, 58, 59, 59, 59, 59, 59, 59, 59, 59, 59},
+	{67, 67, 67, 67, 67, 67, 67, 67, 67, 67, 67, 67, 67, 67, 67, 67},
+	{67, 67, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59},
+	{58, 59, 59, 59, 59, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58},
+	{58, 59, 59, 58, 59, 58, 58, 59, 58, 59, 59, 59, 59, 59, 59, 59},
+	{59, 59, 59, 58, 59, 59, 59, 59, 58, 59, 58, 59, 58, 58, 58, 58},
+	{58, 58, 59, 58, 58, 58, 58, 59, 58, 59, 58, 59, 58, 59, 59, 59},
+	{58, 59, 59, 58, 59, 58, 58, 59, 58, 59, 58, 59, 58, 59, 58, 59},
+	{58, 59, 59, 58, 59, 58, 58, 59, 59, 59, 59, 58, 59, 59, 59, 59},
+	{59, 59, 59, 58, 59, 59, 59, 59, 58, 59, 59, 59, 59, 58, 59, 58},
+	{58, 59, 59, 59, 58, 59, 59, 59, 59, 59, 58, 59, 59, 59, 59, 59},
+};
+static const uint16_t uni_mid[59][64] = {
+	{0, 0, 0, 1, 2, 3, 4, 5, 0, 0, 6, 7, 8, 9, 10, 11, 12, 12, 12, 13, 14, 12, 12, 15, 16, 17, 18, 19, 20, 21, 12, 22, 12, 12, 23, 24, 25, 10, 10, 10, 10, 10, 10, 10, 26, 27, 28, 0, 10, 10, 10, 10, 29, 10, 10, 30, 31, 32, 33, 10, 34, 35, 12, 36},
+	{37, 8, 8, 10, 10, 10, 12, 12, 38, 12, 12, 12, 39, 12, 12, 12, 12, 12, 12, 40, 41, 42, 10, 10, 43, 4, 10, 44, 45, 10, 46, 47, 0, 5, 10, 10, 10, 10, 48, 10, 10, 10, 10, 10, 10, 49, 50, 51, 0, 10, 10, 10, 52, 10, 10, 10, 10, 10, 10, 27, 10, 10, 10, 53},
+	{10, 10, 54, 0, 10, 55, 5, 10, 56, 57, 10, 10, 10, 10, 58, 10, 10, 10, 10, 10, 10, 10, 59, 4, 49, 60, 50, 61, 62, 63, 59, 64, 65, 60, 50, 66, 67, 68, 69, 70, 71, 58, 50, 72, 73, 74, 59, 75, 76, 60, 50, 72, 77, 78, 59, 79, 80, 81, 82, 48, 83, 84, 69, 47},
+	{85, 86, 50, 87, 88, 89, 59, 90, 91, 86, 50, 92, 88, 93, 59, 94, 85, 86, 10, 10, 95, 96, 59, 50, 97, 98, 10, 99, 100, 101, 69, 102, 4, 10, 10, 5, 103, 1, 0, 0, 104, 10, 105, 54, 106, 87, 0, 0, 74, 107, 10, 108, 109, 10, 110, 4, 111, 109, 10, 110, 112, 0, 0, 0},
+	{10, 10, 10, 10, 1, 10, 10, 10, 10, 54, 113, 113, 114, 10, 10, 115, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 116, 117, 10, 10, 116, 10, 10, 118, 119, 11, 10, 10, 10, 119, 10, 10, 10, 52, 75, 110, 10, 0, 10, 10, 10, 10, 10, 120},
+	{4, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 51, 10, 4, 5, 10, 10, 10, 10, 121, 43, 10, 122, 10, 123, 10, 124, 85, 125, 10, 10, 10, 10, 10, 126, 1, 1},
+	{127, 1, 10, 10, 10, 10, 10, 43, 10, 10, 5, 10, 10, 10, 10, 70, 10, 103, 55, 55, 69, 10, 54, 123, 10, 10, 55, 10, 1, 5, 0, 0, 10, 55, 10, 10, 10, 103, 10, 51, 1, 1, 128, 10, 103, 0, 0, 0, 10, 10, 10, 10, 110, 1, 129, 124, 10, 10, 10, 10, 10, 10, 10, 124},
+	{10, 10, 10, 130, 131, 10, 10, 54, 132, 133, 133, 134, 0, 135, 10, 5, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 12, 12, 12, 12, 12, 12, 12, 12, 12, 136, 12, 12, 12, 12, 12, 12, 137, 120, 137, 137, 120, 138, 137, 54, 137, 137, 137, 139, 140, 141, 142, 143},
+	{0, 0, 0, 0, 0, 0, 0, 144, 1, 110, 0, 0, 0, 10, 10, 74, 145, 146, 147, 148, 149, 10, 150, 10, 151, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+	{0, 0, 0, 0, 0, 0, 10, 10, 10, 55, 0, 0, 0, 0, 152, 10, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 69, 10, 124, 0, 0, 0, 0, 0, 0},
+	{0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+	{41, 41, 41, 10, 10, 10, 153, 154, 12, 12, 12, 12, 12, 12, 155, 156, 10, 10, 157, 10, 10, 10, 158, 159, 10, 160, 161, 161, 161, 161, 10, 10, 0, 0, 159, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+	{162, 0, 4, 163, 4, 10, 10, 10, 10, 164, 4, 10, 10, 10, 10, 115, 165, 10, 10, 4, 10, 10, 10, 10, 103, 166, 10, 10, 0, 0, 0, 10, 0, 0, 1, 0, 57, 4, 0, 0, 1, 0, 0, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+	{10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10},
+	{10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 0, 0, 0, 0, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10},
+	{10, 10, 10, 10, 10, 10, 10, 10, 110, 0, 0, 0, 0, 10, 10, 54, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 110, 10, 55, 0, 12, 12, 167, 168, 12, 169, 10, 10, 10, 10, 10, 27, 0, 170, 171, 172, 12, 12, 12, 173, 174, 175, 176, 177, 178, 179, 0, 180},
+	{10, 10, 181, 70, 10, 10, 10, 124, 10, 10, 10, 10, 70, 1, 10, 182, 10, 10, 54, 10, 10, 124, 10, 110, 10, 10, 10, 10, 183, 1, 10, 103, 10, 10, 10, 160, 54, 1, 10, 98, 10, 10, 10, 10, 47, 184, 10, 185, 186, 187, 161, 10, 10, 115, 1, 188, 188, 188, 188, 188, 10, 10, 189, 1},
+	{10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 124, 10, 190, 10, 10, 55},
+	{0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 54, 10, 10, 10, 10, 10, 10, 1, 0, 0, 160, 191, 50, 192, 193, 10, 10, 10, 10, 10, 10, 27, 0, 194, 10, 10},
+	{10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 54, 0, 10, 10, 10, 10, 195, 10, 10, 130, 0, 0, 55, 10, 0, 10, 0, 0, 0, 0, 111, 10, 10, 10, 10, 10, 10, 10, 110, 0, 1, 2, 3, 4, 5, 69, 10, 10, 10, 10, 103, 196, 197, 0, 0},
+	{198, 10, 11, 199, 54, 54, 0, 0, 10, 10, 10, 10, 10, 10, 10, 5, 170, 10, 10, 124, 10, 10, 10, 43, 200, 0, 0, 0, 0, 0, 0, 201, 0, 0, 0, 0, 0, 0, 0, 0, 10, 110, 10, 10, 10, 74, 10, 55, 10, 10, 202, 10, 5, 10, 10, 5, 10, 54, 10, 10, 203, 204, 0, 0},
+	{205, 205, 206, 10, 10, 10, 10, 10, 10, 54, 1, 205, 205, 207, 10, 55, 10, 10, 130, 10, 10, 10, 124, 208, 208, 209, 58, 210, 0, 0, 0, 0, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 160, 10, 70, 130, 0, 211, 10, 10, 212, 0, 0, 0, 0},
+	{213, 10, 10, 214, 10, 215, 10, 216, 10, 103, 170, 0, 0, 0, 10, 217, 10, 55, 10, 1, 0, 0, 0, 0, 10, 10, 10, 218, 10, 195, 10, 10, 219, 220, 10, 221, 43, 0, 10, 103, 10, 10, 0, 0, 109, 10, 190, 0, 10, 10, 10, 70, 10, 215, 10, 222, 10, 27, 75, 0, 0, 0, 0, 0},
+	{10, 10, 10, 10, 43, 0, 0, 0, 223, 223, 223, 224, 10, 10, 10, 225, 10, 10, 130, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 10, 103, 10, 10, 226, 27, 0, 0, 0, 0, 10, 10, 130, 10, 10, 123, 0, 10, 70, 0, 0, 10, 55, 0, 10, 160},
+	{10, 10, 10, 10, 160, 195, 10, 122, 10, 10, 10, 5, 227, 10, 43, 1, 10, 10, 10, 111, 228, 10, 10, 229, 10, 10, 10, 10, 230, 231, 4, 123, 10, 58, 10, 232, 0, 0, 0, 0, 233, 44, 43, 10, 10, 10, 5, 1, 49, 60, 50, 234, 77, 235, 236, 123, 0, 0, 0, 0, 0, 0, 0, 0},
+	{10, 10, 10, 10, 5, 48, 27, 0, 10, 10, 10, 10, 237, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 10, 10, 10, 215, 74, 238, 0, 0, 10, 10, 10, 10, 239, 1, 0, 0, 10, 10, 10, 43, 1, 0, 0, 0, 10, 52, 55, 55, 160, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+	{10, 10, 10, 5, 0, 0, 0, 0, 0, 0, 8, 8, 10, 10, 10, 240, 241, 242, 10, 243, 124, 1, 0, 0, 0, 0, 244, 10, 10, 244, 245, 0, 10, 10, 10, 103, 128, 10, 10, 10, 10, 246, 0, 10, 10, 10, 10, 43, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+	{50, 10, 10, 11, 74, 10, 110, 195, 10, 195, 109, 160, 0, 0, 0, 0, 247, 10, 10, 248, 130, 1, 249, 10, 103, 250, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 10, 160, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 74, 10, 123, 0, 0},
+	{10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 1, 0, 0, 0, 0, 0, 0},
+	{10, 10, 10, 10, 10, 10, 103, 0, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 124, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+	{0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 10, 10, 10, 10, 10, 10, 74},
+	{10, 10, 103, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+	{10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 160, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+	{10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 43, 10, 103, 1, 10, 10, 10, 10, 103, 1, 10, 54, 123, 10, 10, 10, 160, 124, 251, 58, 252, 10, 0, 0, 0, 0, 0, 0, 0},
+	{0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 8, 8, 10, 10, 10, 160, 0, 0, 0, 0, 0, 0, 10, 10, 10, 10, 46, 10, 10, 10, 158, 10, 0, 0, 0, 0, 245, 27},
+	{10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 130},
+	{10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 70, 0, 0, 43, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+	{0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 253},
+	{10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 47, 0, 0, 47, 228, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 55, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+	{10, 10, 10, 10, 10, 10, 5, 110, 43, 254, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+	{0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 10, 10, 54, 10, 160, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+	{0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 255, 256, 257, 0, 258, 0, 0, 0, 0, 0, 0, 0, 0, 0, 259, 0, 0, 0, 0, 0, 0, 0, 0, 0, 10, 124, 0, 0, 0, 0, 0, 0, 10, 43, 0, 0, 0, 0, 0, 0, 0, 0},
+	{10, 10, 10, 10, 10, 111, 10, 10, 10, 85, 260, 261, 262, 10, 10, 10, 263, 264, 10, 265, 266, 86, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 215, 10, 86, 115, 10, 115, 10, 111, 10, 111, 103, 10, 103, 10, 50, 10, 50, 10, 267, 10, 10, 10},
+	{0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 10, 10, 10, 190, 10, 10, 110, 268, 269, 129, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+	{0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 10, 103, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+	{11, 270, 271, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 10, 10, 110, 54, 272, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 10, 103, 0, 10, 10, 10, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+	{0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 273, 103},
+	{10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 274, 160, 0, 0, 275, 275, 276, 10, 55, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+	{0, 0, 0, 0, 0, 0, 0, 4, 10, 10, 198, 277, 0, 0, 0, 0, 4, 10, 44, 54, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 262, 10, 278, 279, 280, 281, 282, 283, 251, 55, 284, 55, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+	{0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 110, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+	{0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1},
+	{10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 0, 0, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10},
+	{10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 43, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10},
+	{10, 54, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10},
+	{10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 27, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10},
+	{10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 74, 0},
+	{10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 54, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+	{10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 5, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+	{0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+};
+static const uint8_t uni_top[1088] = {
+	0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 13, 13,
+	13, 13, 13, 14, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13,
+	13, 13, 13, 13, 13, 13, 13, 13, 13, 15, 16, 13, 13, 13, 13, 13,
+	13, 13, 13, 13, 13, 17, 10, 10, 10, 10, 10, 10, 10, 10, 18, 19,
+	20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 10, 30, 13, 31, 10, 10,
+	10, 32, 10, 10, 10, 10, 10, 10, 10, 10, 33, 34, 13, 13, 13, 13,
+	13, 35, 13, 36, 10, 10, 10, 10, 10, 10, 10, 37, 38, 10, 10, 39,
+	10, 10, 10, 40, 41, 42, 43, 44, 45, 46, 47, 48, 49, 10, 50, 10,
+	13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13,
+	13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13,
+	13, 13, 13, 13, 13, 13, 13, 13, 13, 51, 13, 13, 13, 52, 53, 13,
+	13, 13, 13, 54, 13, 13, 13, 13, 13, 13, 55, 10, 10, 10, 56, 10,
+	13, 13, 13, 13, 57, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+	10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+	10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+	10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+	10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+	10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+	10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+	10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+	10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+	10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+	10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+	10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+	10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+	10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+	10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+	10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+	10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+	10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+	10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+	10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+	10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+	10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+	10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+	10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+	10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+	10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+	10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+	10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+	10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+	10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+	10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+	10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+	10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+	10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+	10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+	10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+	10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+	10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+	10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+	10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+	10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+	10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+	10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+	10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+	58, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+	10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+	10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+	10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+	10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+	10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+	10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+	10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+	10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+	10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+	10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+	10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+};